@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "ledger.h"
+
+#define MAX_MERGE_FANIN 64
+#define RUN_BUFFER_SIZE (64 * 1024)
+
+// Only the first 24 characters of a description are ever printed, so that
+// is all a spilled record keeps.
+typedef struct {
+    int64_t amount;
+    int32_t timestamp;
+    uint8_t desc_len;
+    char desc[24];
+} SpillRecord;
+
+// A sorted run on disk: the records, plus their timestamps on their own so
+// the duplicate check before rendering reads a tenth of the data.
+typedef struct {
+    FILE *records;
+    FILE *keys;
+    long num_records;
+} SpillRun;
+
+typedef struct {
+    SpillRun *run;
+    long remaining;
+    SpillRecord rec;
+    int32_t timestamp;
+} RunReader;
+
+// Runs waiting to be merged are runs[first..num_runs).
+typedef struct {
+    SpillRun *runs;
+    int first, num_runs, max_runs;
+} RunList;
+
+// What the in-memory part of the sort holds per record.
+typedef struct {
+    TransactionView *trans;
+    char *descs;
+    SortKey *keys, *tmp;
+    int num_trans, capacity;
+} RunBuffer;
+
+static FILE *SpillFile() {
+    char path[MAXPATHLENGTH];
+    const char *dir = getenv("TMPDIR");
+    FILE *fp = NULL;
+
+    snprintf(path, sizeof(path), "%s/warmup1-XXXXXX", dir != NULL ? dir : "/tmp");
+    int fd = mkstemp(path);
+    if (fd >= 0) {
+        unlink(path);  // gone as soon as we close it
+        fp = fdopen(fd, "w+b");
+    }
+    if (fp == NULL) {
+        perror("Error: Could not create temporary file");
+        exit(EXIT_FAILURE);
+    }
+    setvbuf(fp, NULL, _IOFBF, RUN_BUFFER_SIZE);
+    return fp;
+}
+
+static void NewRun(SpillRun *run) {
+    run->records = SpillFile();
+    run->keys = SpillFile();
+    run->num_records = 0;
+}
+
+static void WriteRecord(SpillRun *run, SpillRecord *rec) {
+    if (fwrite(rec, sizeof(SpillRecord), 1, run->records) != 1 ||
+            fwrite(&rec->timestamp, sizeof(int32_t), 1, run->keys) != 1) {
+        perror("Error: Could not write temporary file");
+        exit(EXIT_FAILURE);
+    }
+    run->num_records++;
+}
+
+static void FreeRun(SpillRun *run) {
+    fclose(run->records);
+    fclose(run->keys);
+}
+
+static void DuplicateError(int timestamp) {
+    fprintf(stderr, "Error: Duplicate timestamp found: %d\n", timestamp);
+    exit(EXIT_FAILURE);
+}
+
+// Sort what is buffered; returns the sorted keys.
+static SortKey *SortRunBuffer(RunBuffer *buffer, int num_workers) {
+    int dup = -1;
+
+    for (int i = 0; i < buffer->num_trans; i++) {
+        buffer->keys[i].item = &buffer->trans[i];
+        buffer->keys[i].key = (uint32_t)buffer->trans[i].timestamp ^ 0x80000000u;
+    }
+    SortKey *sorted = SortKeys(buffer->keys, buffer->tmp, buffer->num_trans, num_workers, &dup);
+    if (dup >= 0) DuplicateError(((TransactionView *)sorted[dup].item)->timestamp);
+    return sorted;
+}
+
+static void SpillRunBuffer(RunBuffer *buffer, SpillRun *run, int num_workers) {
+    SortKey *sorted = SortRunBuffer(buffer, num_workers);
+    SpillRecord rec;
+
+    memset(&rec, 0, sizeof(rec));
+    NewRun(run);
+    for (int i = 0; i < buffer->num_trans; i++) {
+        TransactionView *trans = (TransactionView *)sorted[i].item;
+        rec.amount = trans->amount;
+        rec.timestamp = trans->timestamp;
+        rec.desc_len = (uint8_t)trans->desc_len;
+        memcpy(rec.desc, buffer->descs + trans->desc_off, trans->desc_len);
+        WriteRecord(run, &rec);
+    }
+    buffer->num_trans = 0;
+}
+
+static int ReadNext(RunReader *reader, int keys_only) {
+    if (reader->remaining == 0) return FALSE;
+    reader->remaining--;
+    if (keys_only) {
+        if (fread(&reader->timestamp, sizeof(int32_t), 1, reader->run->keys) == 1) return TRUE;
+    } else {
+        if (fread(&reader->rec, sizeof(SpillRecord), 1, reader->run->records) == 1) {
+            reader->timestamp = reader->rec.timestamp;
+            return TRUE;
+        }
+    }
+    perror("Error: Could not read temporary file");
+    exit(EXIT_FAILURE);
+}
+
+static void SiftDown(RunReader **heap, int size, int i) {
+    RunReader *reader = heap[i];
+
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= size) break;
+        if (child + 1 < size && heap[child + 1]->timestamp < heap[child]->timestamp) child++;
+        if (heap[child]->timestamp >= reader->timestamp) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = reader;
+}
+
+// k-way merge of runs.  With keys_only, only look for duplicates; otherwise
+// send the merged records to dst (another run) or render them to out.
+static void MergeRuns(SpillRun *runs, int k, int keys_only, SpillRun *dst, LedgerOutput *out) {
+    RunReader readers[MAX_MERGE_FANIN], *heap[MAX_MERGE_FANIN];
+    int heap_size = 0, i = 0, have_last = FALSE;
+    int32_t last = 0;
+    int64_t balance = 0;
+    TransactionView trans;
+
+    for (i = 0; i < k; i++) {
+        FILE *fp = keys_only ? runs[i].keys : runs[i].records;
+        fflush(fp);
+        rewind(fp);
+        readers[i].run = &runs[i];
+        readers[i].remaining = runs[i].num_records;
+        if (ReadNext(&readers[i], keys_only)) heap[heap_size++] = &readers[i];
+    }
+    for (i = heap_size / 2 - 1; i >= 0; i--) {
+        SiftDown(heap, heap_size, i);
+    }
+
+    memset(&trans, 0, sizeof(trans));
+    while (heap_size > 0) {
+        RunReader *reader = heap[0];
+
+        if (have_last && reader->timestamp == last) DuplicateError(last);
+        last = reader->timestamp;
+        have_last = TRUE;
+
+        if (dst != NULL) {
+            WriteRecord(dst, &reader->rec);
+        } else if (out != NULL) {
+            trans.timestamp = reader->rec.timestamp;
+            trans.amount = reader->rec.amount;
+            trans.desc_off = 0;
+            trans.desc_len = reader->rec.desc_len;
+            balance = AddMoney(balance, trans.amount);
+            OutputRow(out, &trans, reader->rec.desc, balance);
+        }
+
+        if (!ReadNext(reader, keys_only)) {
+            heap[0] = heap[--heap_size];
+        }
+        if (heap_size > 0) SiftDown(heap, heap_size, 0);
+    }
+}
+
+static SpillRun *AddRun(RunList *list) {
+    if (list->num_runs == list->max_runs) {
+        list->max_runs = list->max_runs == 0 ? 16 : 2 * list->max_runs;
+        list->runs = (SpillRun *)realloc(list->runs, list->max_runs * sizeof(SpillRun));
+        if (list->runs == NULL) {
+            fprintf(stderr, "Error: Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return &list->runs[list->num_runs++];
+}
+
+// Replace the k oldest pending runs by their merge.
+static void MergeOldestRuns(RunList *list, int k) {
+    SpillRun merged;
+
+    NewRun(&merged);
+    MergeRuns(&list->runs[list->first], k, FALSE, &merged, NULL);
+    for (int i = list->first; i < list->first + k; i++) {
+        FreeRun(&list->runs[i]);
+    }
+    list->first += k;
+    *AddRun(list) = merged;
+}
+
+// Sort mode for ledgers that do not fit in memory.  Lines are streamed in,
+// and every time memory_budget bytes worth of records have been read they
+// are sorted and spilled to a temporary file as a run.  Runs are merged
+// MAX_MERGE_FANIN at a time until one merge can take all of them (this also
+// keeps the number of open files bounded), checked for duplicates, and then
+// merged once more straight into the table.  The running balance is kept
+// during that last merge.
+void ExternalSortAndRender(const char *path, size_t memory_budget, int num_workers, LedgerOutput *out) {
+    size_t per_record = sizeof(TransactionView) + 2 * sizeof(SortKey) + 24;
+    RunBuffer buffer;
+    LineReader reader;
+    RunList list;
+    const char *line = NULL;
+    int len = 0, i = 0;
+
+    if (!LineReaderOpen(&reader, path, STDIN_CHUNK_SIZE)) {
+        fprintf(stderr, "Error: Could not open input file: %s\n", path != NULL ? path : "(stdin)");
+        exit(EXIT_FAILURE);
+    }
+    if (LineReaderIsBinaryLedger(&reader)) {
+        fprintf(stderr, "Error: binary ledger not supported with -m, sort it without -m\n");
+        exit(EXIT_FAILURE);
+    }
+
+    buffer.capacity = (int)min(memory_budget / per_record, (size_t)0x7fffffff);
+    buffer.capacity = max(buffer.capacity, 1024);
+    buffer.num_trans = 0;
+    buffer.trans = (TransactionView *)malloc(buffer.capacity * sizeof(TransactionView));
+    buffer.descs = (char *)malloc((size_t)buffer.capacity * 24);
+    buffer.keys = (SortKey *)malloc(buffer.capacity * sizeof(SortKey));
+    buffer.tmp = (SortKey *)malloc(buffer.capacity * sizeof(SortKey));
+    if (buffer.trans == NULL || buffer.descs == NULL || buffer.keys == NULL || buffer.tmp == NULL) {
+        fprintf(stderr, "Error: Could not allocate the sort memory budget\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(&list, 0, sizeof(list));
+
+    while (LineReaderNext(&reader, &line, &len)) {
+        TransactionView *trans = &buffer.trans[buffer.num_trans];
+
+        if (!ParseTransaction(line, 0, len, trans)) {
+            fprintf(stderr, "Error: malformed line\n");
+            exit(EXIT_FAILURE);
+        }
+        // keep the printable part of the description in the run buffer
+        char *desc = buffer.descs + (size_t)buffer.num_trans * 24;
+        trans->desc_len = min(trans->desc_len, 24);
+        memcpy(desc, line + trans->desc_off, trans->desc_len);
+        trans->desc_off = (size_t)(desc - buffer.descs);
+
+        if (++buffer.num_trans == buffer.capacity) {
+            SpillRunBuffer(&buffer, AddRun(&list), num_workers);
+            if (list.num_runs - list.first == 2 * MAX_MERGE_FANIN) {
+                MergeOldestRuns(&list, MAX_MERGE_FANIN);
+            }
+        }
+    }
+    LineReaderClose(&reader);
+
+    if (list.num_runs == 0) {
+        // it all fit, no need to touch the disk
+        SortKey *sorted = SortRunBuffer(&buffer, num_workers);
+        int64_t balance = 0;
+
+        OutputHeader(out);
+        for (i = 0; i < buffer.num_trans; i++) {
+            TransactionView *trans = (TransactionView *)sorted[i].item;
+            balance = AddMoney(balance, trans->amount);
+            OutputRow(out, trans, buffer.descs, balance);
+        }
+        OutputFooter(out);
+    } else {
+        if (buffer.num_trans > 0) {
+            SpillRunBuffer(&buffer, AddRun(&list), num_workers);
+        }
+        // merge just enough runs that the rest fit in one final merge
+        while (list.num_runs - list.first > MAX_MERGE_FANIN) {
+            MergeOldestRuns(&list, min(MAX_MERGE_FANIN, list.num_runs - list.first - MAX_MERGE_FANIN + 1));
+        }
+
+        SpillRun *runs = &list.runs[list.first];
+        int k = list.num_runs - list.first;
+        MergeRuns(runs, k, TRUE, NULL, NULL);
+        OutputHeader(out);
+        MergeRuns(runs, k, FALSE, NULL, out);
+        OutputFooter(out);
+
+        for (i = 0; i < k; i++) {
+            FreeRun(&runs[i]);
+        }
+        free(list.runs);
+    }
+
+    free(buffer.trans);
+    free(buffer.descs);
+    free(buffer.keys);
+    free(buffer.tmp);
+}
@@ -0,0 +1,683 @@
+#define _GNU_SOURCE  /* vmsplice() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <pthread.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "ledger.h"
+
+// Map the file at path, or slurp stdin (or anything that cannot be mapped)
+// with large read()s into one growing buffer.
+int OpenLedgerInput(LedgerInput *input, const char *path) {
+    int fd = STDIN_FILENO;
+    struct stat st;
+
+    input->data = NULL;
+    input->size = 0;
+    input->mapped = FALSE;
+    input->num_batches = 0;
+    memset(&input->descs, 0, sizeof(input->descs));
+
+    if (path != NULL) {
+        fd = open(path, O_RDONLY);
+        if (fd < 0) return FALSE;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                (void)madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+                close(fd);
+                input->data = (char *)data;
+                input->size = (size_t)st.st_size;
+                input->mapped = TRUE;
+                return TRUE;
+            }
+        }
+    }
+
+    size_t capacity = 0;
+    for (;;) {
+        if (capacity - input->size < STDIN_CHUNK_SIZE) {
+            capacity = capacity == 0 ? 4 * STDIN_CHUNK_SIZE : capacity * 2;
+            char *data = (char *)realloc(input->data, capacity);
+            if (data == NULL) {
+                fprintf(stderr, "Error: Out of memory reading input\n");
+                exit(EXIT_FAILURE);
+            }
+            input->data = data;
+        }
+        ssize_t n = read(fd, input->data + input->size, capacity - input->size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (path != NULL) close(fd);
+            return FALSE;
+        }
+        if (n == 0) break;
+        input->size += (size_t)n;
+    }
+    if (path != NULL) close(fd);
+    return TRUE;
+}
+
+// Let go of the text once everything needed from it has been loaded; the
+// transactions and their descriptions stay.
+void ReleaseLedgerText(LedgerInput *input) {
+    if (input->mapped) {
+        if (input->data != NULL) munmap(input->data, input->size);
+    } else {
+        free(input->data);
+    }
+    input->data = NULL;
+    input->size = 0;
+    input->mapped = FALSE;
+}
+
+void CloseLedgerInput(LedgerInput *input) {
+    ReleaseLedgerText(input);
+    while (input->num_batches > 0) {
+        free(input->batches[--input->num_batches]);
+    }
+    ArenaFree(&input->descs);
+}
+
+// buf_size must be more than MAX_LINE_LENGTH.
+int LineReaderOpen(LineReader *reader, const char *path, size_t buf_size) {
+    reader->fd = (path == NULL) ? STDIN_FILENO : open(path, O_RDONLY);
+    if (reader->fd < 0) return FALSE;
+    reader->size = buf_size;
+    reader->buf = (char *)malloc(buf_size);
+    if (reader->buf == NULL) {
+        fprintf(stderr, "Error: Out of memory reading input\n");
+        exit(EXIT_FAILURE);
+    }
+    reader->start = reader->end = 0;
+    reader->eof = FALSE;
+    return TRUE;
+}
+
+// Hand out the next line (without its newline).  Returns TRUE for a line,
+// FALSE at the end of the input; a line that is too long is an error.
+int LineReaderNext(LineReader *reader, const char **line, int *len) {
+    for (;;) {
+        char *data = reader->buf + reader->start;
+        size_t avail = reader->end - reader->start;
+        char *eol = (char *)memchr(data, '\n', avail);
+
+        if (eol != NULL || (reader->eof && avail > 0)) {
+            size_t line_len = (eol != NULL) ? (size_t)(eol - data) : avail;
+            if (line_len >= MAX_LINE_LENGTH - 1) break;
+            *line = data;
+            *len = (int)line_len;
+            reader->start += line_len + (eol != NULL ? 1 : 0);
+            return TRUE;
+        }
+        if (reader->eof) return FALSE;
+        if (avail >= MAX_LINE_LENGTH - 1) break;
+
+        memmove(reader->buf, data, avail);
+        reader->start = 0;
+        reader->end = avail;
+        ssize_t n = read(reader->fd, reader->buf + reader->end, reader->size - reader->end);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Error: read failed");
+            exit(EXIT_FAILURE);
+        }
+        if (n == 0) reader->eof = TRUE;
+        reader->end += (size_t)n;
+    }
+    fprintf(stderr, "Error: Line exceeds 1024 characters\n");
+    exit(EXIT_FAILURE);
+}
+
+// TRUE if the input starts with LEDGER_BIN_MAGIC.  Call it before the
+// first LineReaderNext(); it reads ahead far enough to tell but consumes
+// nothing.
+int LineReaderIsBinaryLedger(LineReader *reader) {
+    size_t magic_len = strlen(LEDGER_BIN_MAGIC);
+
+    while (reader->end - reader->start < magic_len && !reader->eof) {
+        ssize_t n = read(reader->fd, reader->buf + reader->end, reader->size - reader->end);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Error: read failed");
+            exit(EXIT_FAILURE);
+        }
+        if (n == 0) reader->eof = TRUE;
+        reader->end += (size_t)n;
+    }
+    return reader->end - reader->start >= magic_len &&
+           memcmp(reader->buf + reader->start, LEDGER_BIN_MAGIC, magic_len) == 0;
+}
+
+// TRUE if LineReaderNext() can return without reading (and so without
+// possibly waiting on a pipe).
+int LineReaderPending(LineReader *reader) {
+    return reader->eof || memchr(reader->buf + reader->start, '\n', reader->end - reader->start) != NULL;
+}
+
+void LineReaderClose(LineReader *reader) {
+    if (reader->fd != STDIN_FILENO) close(reader->fd);
+    free(reader->buf);
+    reader->buf = NULL;
+}
+
+static int IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+// %d: optional sign and at least one digit.  Out-of-range values end up
+// where sscanf() puts them (strtol() saturates, then truncated to int).
+static const char *ParseInt(const char *p, const char *end, int *value) {
+    int negative = FALSE;
+    uint64_t v = 0;
+    int overflow = FALSE;
+    const char *digits = NULL;
+
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = (*p == '-');
+        p++;
+    }
+    for (digits = p; p < end && *p >= '0' && *p <= '9'; p++) {
+        v = v * 10 + (uint64_t)(*p - '0');
+        if (v > (uint64_t)INT64_MAX) overflow = TRUE;
+    }
+    if (p == digits) return NULL;
+
+    if (overflow) {
+        *value = negative ? (int)INT64_MIN : (int)INT64_MAX;
+    } else {
+        *value = (int)(negative ? -(int64_t)v : (int64_t)v);
+    }
+    return p;
+}
+
+// Amounts that are not plain decimals (exponents, hex, inf/nan) are rare
+// and still accepted the way %lf accepts them.
+static const char *ParseAmountSlow(const char *p, const char *end, int64_t *cents) {
+    char buf[64];
+    int len = 0;
+    char *endptr = NULL;
+
+    while (p + len < end && len < (int)sizeof(buf) - 1 && !IsSpace(p[len])) {
+        buf[len] = p[len];
+        len++;
+    }
+    buf[len] = '\0';
+
+    double v = strtod(buf, &endptr);
+    if (endptr == buf) return NULL;
+
+    v *= 100.0;
+    if (v != v) {
+        *cents = 0;
+    } else if (v >= 9e18) {
+        *cents = INT64_MAX;
+    } else if (v <= -9e18) {
+        *cents = -INT64_MAX;
+    } else {
+        *cents = (int64_t)(v >= 0 ? v + 0.5 : v - 0.5);
+    }
+    return p + (endptr - buf);
+}
+
+// %lf straight into cents.  Digits past the second decimal round half up.
+static const char *ParseAmount(const char *p, const char *end, int64_t *cents) {
+    const char *start = p;
+    int negative = FALSE, num_digits = 0, num_decimals = 0;
+    int64_t v = 0;
+
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = (*p == '-');
+        p++;
+    }
+    for (; p < end && *p >= '0' && *p <= '9'; p++, num_digits++) {
+        if (v < (int64_t)1e15) v = v * 10 + (*p - '0');
+    }
+    v *= 100;
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, num_digits++, num_decimals++) {
+            if (num_decimals == 0) {
+                v += (*p - '0') * 10;
+            } else if (num_decimals == 1) {
+                v += (*p - '0');
+            } else if (num_decimals == 2 && *p >= '5') {
+                v++;
+            }
+        }
+    }
+    if (num_digits == 0 || (p < end && (*p == 'e' || *p == 'E' || *p == 'x' || *p == 'X'))) {
+        return ParseAmountSlow(start, end, cents);
+    }
+
+    *cents = negative ? -v : v;
+    return p;
+}
+
+// Parse one line (without its newline) of the form
+//     sign TAB timestamp TAB amount TAB description
+// with the same rules as sscanf(line, "%c\t%d\t%lf\t%[^\n]", ...): each TAB
+// stands for any run of whitespace and the description must not be empty.
+// The description is recorded as an offset into data.
+int ParseTransaction(const char *data, size_t line_off, int len, TransactionView *trans) {
+    const char *p = data + line_off, *end = p + len;
+    char sign;
+
+    if (p == end) return FALSE;
+    sign = *p++;
+    if (sign != '+' && sign != '-') return FALSE;
+
+    while (p < end && IsSpace(*p)) p++;
+    if ((p = ParseInt(p, end, &trans->timestamp)) == NULL) return FALSE;
+
+    while (p < end && IsSpace(*p)) p++;
+    if ((p = ParseAmount(p, end, &trans->amount)) == NULL) return FALSE;
+    if (sign == '-') trans->amount = -trans->amount;
+
+    while (p < end && IsSpace(*p)) p++;
+    if (p == end) return FALSE;
+
+    trans->desc_off = (size_t)(p - data);
+    trans->desc_len = (int)(end - p);
+    return TRUE;
+}
+
+enum { LOAD_OK, LOAD_LINE_TOO_LONG, LOAD_MALFORMED, LOAD_NO_MEMORY };
+
+// One slice of the input, [start, end) always begins and ends on a line.
+// Each slice interns its descriptions into its own arena.
+typedef struct {
+    const char *data;
+    size_t start, end;
+    Transaction *trans;
+    int num_trans;
+    StringArena descs;
+    int error;  // the first problem in this slice, parsing stops there
+} LoadChunk;
+
+static void *LoadChunkThread(void *param) {
+    LoadChunk *chunk = (LoadChunk *)param;
+    const char *data = chunk->data;
+    size_t pos = chunk->start;
+    int capacity = (int)((chunk->end - chunk->start) / 32) + 16;
+
+    chunk->trans = (Transaction *)malloc(capacity * sizeof(Transaction));
+    if (chunk->trans == NULL || !ArenaInit(&chunk->descs)) {
+        chunk->error = LOAD_NO_MEMORY;
+        return NULL;
+    }
+    while (pos < chunk->end) {
+        const char *eol = (const char *)memchr(data + pos, '\n', chunk->end - pos);
+        size_t len = (eol != NULL ? (size_t)(eol - data) : chunk->end) - pos;
+
+        if (len >= MAX_LINE_LENGTH - 1) {
+            chunk->error = LOAD_LINE_TOO_LONG;
+            return NULL;
+        }
+        if (chunk->num_trans == capacity) {
+            Transaction *trans = (Transaction *)realloc(chunk->trans, 2 * capacity * sizeof(Transaction));
+            if (trans == NULL) {
+                chunk->error = LOAD_NO_MEMORY;
+                return NULL;
+            }
+            chunk->trans = trans;
+            capacity *= 2;
+        }
+        TransactionView view;
+        if (!ParseTransaction(data, pos, (int)len, &view)) {
+            chunk->error = LOAD_MALFORMED;
+            return NULL;
+        }
+        Transaction *trans = &chunk->trans[chunk->num_trans++];
+        trans->timestamp = view.timestamp;
+        trans->amount = view.amount;
+        trans->desc = ArenaIntern(&chunk->descs, data + view.desc_off, view.desc_len);
+        if (trans->desc == ARENA_NO_ID) {
+            chunk->error = LOAD_NO_MEMORY;
+            return NULL;
+        }
+
+        pos += len + 1;
+    }
+    return NULL;
+}
+
+// Split the input at line boundaries into num_workers slices, parse them in
+// parallel, then append everything to pList in file order.  If any line is
+// bad, the error reported is the one for the first bad line in the file.
+void LoadTransactions(LedgerInput *input, My402List *pList, int num_workers) {
+    LoadChunk chunks[MAX_LOAD_WORKERS];
+    pthread_t threads[MAX_LOAD_WORKERS];
+    size_t pos = 0;
+    int i = 0;
+
+    num_workers = max(1, min(num_workers, MAX_LOAD_WORKERS));
+    if (input->size < (size_t)num_workers * 65536) {
+        // not worth a thread per slice
+        num_workers = (int)(input->size / 65536) + 1;
+    }
+
+    for (i = 0; i < num_workers; i++) {
+        size_t end = (i == num_workers - 1) ? input->size : input->size / num_workers * (i + 1);
+        if (end < pos) end = pos;
+        if (end < input->size) {
+            const char *eol = (const char *)memchr(input->data + end, '\n', input->size - end);
+            end = (eol != NULL) ? (size_t)(eol - input->data) + 1 : input->size;
+        }
+        chunks[i].data = input->data;
+        chunks[i].start = pos;
+        chunks[i].end = end;
+        chunks[i].trans = NULL;
+        chunks[i].num_trans = 0;
+        memset(&chunks[i].descs, 0, sizeof(chunks[i].descs));
+        chunks[i].error = LOAD_OK;
+        pos = end;
+    }
+
+    for (i = 1; i < num_workers; i++) {
+        if (pthread_create(&threads[i], NULL, LoadChunkThread, &chunks[i]) != 0) {
+            fprintf(stderr, "Error: Could not create loader thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    LoadChunkThread(&chunks[0]);
+    for (i = 1; i < num_workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (i = 0; i < num_workers; i++) {
+        switch (chunks[i].error) {
+        case LOAD_LINE_TOO_LONG:
+            fprintf(stderr, "Error: Line exceeds 1024 characters\n");
+            exit(EXIT_FAILURE);
+        case LOAD_MALFORMED:
+            fprintf(stderr, "Error: malformed line\n");
+            exit(EXIT_FAILURE);
+        case LOAD_NO_MEMORY:
+            fprintf(stderr, "Error: Out of memory reading input\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // the first slice's arena becomes the input's, the others are moved
+    // into it and their transactions given the new ids
+    input->descs = chunks[0].descs;
+    for (i = 1; i < num_workers; i++) {
+        if (!ArenaMoveInto(&input->descs, &chunks[i].descs)) {
+            fprintf(stderr, "Error: Out of memory reading input\n");
+            exit(EXIT_FAILURE);
+        }
+        for (int j = 0; j < chunks[i].num_trans; j++) {
+            chunks[i].trans[j].desc = ArenaMovedId(&chunks[i].descs, chunks[i].trans[j].desc);
+        }
+        ArenaFree(&chunks[i].descs);
+    }
+
+    for (i = 0; i < num_workers; i++) {
+        for (int j = 0; j < chunks[i].num_trans; j++) {
+            My402ListAppendElem(pList, &chunks[i].trans[j].link);
+        }
+        input->batches[input->num_batches++] = chunks[i].trans;
+    }
+}
+
+static const char digit_pairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+// balance + amount, clamped to +/-INT64_MAX rather than overflowing, the
+// way ParseAmountSlow() clamps huge amounts.  Once clamped it stays there,
+// as an infinite double would, so the balance keeps printing as
+// "?,???,???.??".
+int64_t AddMoney(int64_t balance, int64_t amount) {
+    int64_t sum = 0;
+
+    if (balance == INT64_MAX || balance == -INT64_MAX) return balance;
+    if (__builtin_add_overflow(balance, amount, &sum)) return amount > 0 ? INT64_MAX : -INT64_MAX;
+    return sum == INT64_MIN ? -INT64_MAX : sum;
+}
+
+// Write cents as the 14-character Amount/Balance field, e.g.
+// "     1,234.56 " or "(    1,234.56)", and "?,???,???.??" once the
+// value does not fit.  out is not NUL-terminated.
+void FormatMoney(char *out, int64_t cents) {
+    int negative = cents < 0;
+    uint64_t v = negative ? (uint64_t)0 - (uint64_t)cents : (uint64_t)cents;
+
+    if (v >= 1000000000) {
+        // split so "??)" is not read as a trigraph
+        memcpy(out, negative ? "(?,???,???.?" "?)" : " ?,???,???.?? ", MONEY_FIELD_WIDTH);
+        return;
+    }
+
+    uint32_t dollars = (uint32_t)(v / 100);
+    const char *pair = &digit_pairs[2 * (v % 100)];
+    char *p = out + MONEY_FIELD_WIDTH - 2;
+
+    memset(out, ' ', MONEY_FIELD_WIDTH);
+    out[0] = negative ? '(' : ' ';
+    out[MONEY_FIELD_WIDTH - 1] = negative ? ')' : ' ';
+
+    p[0] = pair[1];
+    p[-1] = pair[0];
+    p[-2] = '.';
+    p -= 3;
+
+    while (dollars >= 1000) {
+        uint32_t group = dollars % 1000;
+        pair = &digit_pairs[2 * (group % 100)];
+        p[0] = pair[1];
+        p[-1] = pair[0];
+        p[-2] = (char)('0' + group / 100);
+        p[-3] = ',';
+        p -= 4;
+        dollars /= 1000;
+    }
+    if (dollars >= 10) {
+        pair = &digit_pairs[2 * (dollars % 100)];
+        p[0] = pair[1];
+        p[-1] = pair[0];
+        if (dollars >= 100) p[-2] = (char)('0' + dollars / 100);
+    } else {
+        p[0] = (char)('0' + dollars);
+    }
+}
+
+void DateCacheInit(DateCache *cache) {
+    tzset();
+    for (int i = 0; i < DATE_CACHE_SIZE; i++) {
+        cache->slot[i].lo = cache->slot[i].hi = 0;
+    }
+}
+
+// Write the 15-character Date field, e.g. "Tue Feb  5 2008", the same text
+// ctime() gives minus the time of day.  Uses localtime_r() and a cache owned
+// by the caller, so it is safe to call from several threads.  out is not
+// NUL-terminated.
+void FormatDate(char *out, int timestamp, DateCache *cache) {
+    static const char day_names[] = "SunMonTueWedThuFriSat";
+    static const char month_names[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    int64_t t = timestamp;
+    int index = (int)((uint32_t)(t / 86400 + (t < 0 ? -1 : 0)) % DATE_CACHE_SIZE);
+
+    if (cache->slot[index].lo <= t && t < cache->slot[index].hi) {
+        memcpy(out, cache->slot[index].text, DATE_FIELD_WIDTH);
+        return;
+    }
+
+    time_t rawtime = (time_t)timestamp;
+    struct tm tm;
+    char *text = cache->slot[index].text;
+
+    if (localtime_r(&rawtime, &tm) == NULL) {
+        memcpy(out, "??? ??? ?? ????", DATE_FIELD_WIDTH);
+        return;
+    }
+    memcpy(text, &day_names[3 * tm.tm_wday], 3);
+    text[3] = ' ';
+    memcpy(text + 4, &month_names[3 * tm.tm_mon], 3);
+    text[7] = ' ';
+    text[8] = tm.tm_mday >= 10 ? (char)('0' + tm.tm_mday / 10) : ' ';
+    text[9] = (char)('0' + tm.tm_mday % 10);
+    text[10] = ' ';
+    int year = (tm.tm_year + 1900) % 10000;
+    memcpy(text + 11, &digit_pairs[2 * (year / 100)], 2);
+    memcpy(text + 13, &digit_pairs[2 * (year % 100)], 2);
+    memcpy(out, text, DATE_FIELD_WIDTH);
+
+    // Local midnight is within an hour of what the wall clock says (DST),
+    // so only cache the part of the day that is certainly this date.
+    int64_t since_midnight = tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+    int64_t lo = t - since_midnight + 3600, hi = t - since_midnight + 86400 - 3600;
+    cache->slot[index].lo = min(lo, t);
+    cache->slot[index].hi = max(hi, t + 1);
+}
+
+static const char table_border[] =
+    "+-----------------+--------------------------+----------------+----------------+\n";
+static const char table_heading[] =
+    "|       Date      | Description              |         Amount |        Balance |\n";
+static const char row_template[] =
+    "|                 |                          |                |                |\n";
+
+static void NewOutputBuffer(LedgerOutput *out) {
+    out->len = 0;
+    if (out->use_vmsplice) {
+        void *buf = mmap(NULL, OUTPUT_BUFFER_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buf != MAP_FAILED) {
+            out->buf = (char *)buf;
+            out->buf_mapped = TRUE;
+            return;
+        }
+        out->use_vmsplice = FALSE;
+    }
+    out->buf = (char *)malloc(OUTPUT_BUFFER_SIZE);
+    out->buf_mapped = FALSE;
+    if (out->buf == NULL) {
+        fprintf(stderr, "Error: Out of memory for output buffer\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void FreeOutputBuffer(LedgerOutput *out) {
+    if (out->buf_mapped) {
+        munmap(out->buf, OUTPUT_BUFFER_SIZE);
+    } else {
+        free(out->buf);
+    }
+    out->buf = NULL;
+}
+
+void OutputInit(LedgerOutput *out, int fd) {
+    struct stat st;
+
+    out->fd = fd;
+    out->use_vmsplice = FALSE;
+#ifdef __linux__
+    out->use_vmsplice = (fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode));
+#endif /* __linux__ */
+    NewOutputBuffer(out);
+    DateCacheInit(&out->dates);
+}
+
+// Hand everything buffered so far to the kernel.  A vmsplice()d buffer
+// stays referenced by the pipe until the reader consumes it, so it is never
+// written to again: it is unmapped and a fresh one takes its place.
+void OutputFlush(LedgerOutput *out) {
+    size_t done = 0, spliced = 0;
+
+#ifdef __linux__
+    while (out->use_vmsplice && done < out->len) {
+        struct iovec iov;
+        iov.iov_base = out->buf + done;
+        iov.iov_len = out->len - done;
+        ssize_t n = vmsplice(out->fd, &iov, 1, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // not supported for this fd, use write() from now on
+            out->use_vmsplice = FALSE;
+            break;
+        }
+        done += (size_t)n;
+        spliced += (size_t)n;
+    }
+#endif /* __linux__ */
+    while (done < out->len) {
+        ssize_t n = write(out->fd, out->buf + done, out->len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Error: write failed");
+            exit(EXIT_FAILURE);
+        }
+        done += (size_t)n;
+    }
+
+    if (spliced > 0) {
+        FreeOutputBuffer(out);
+        NewOutputBuffer(out);
+    }
+    out->len = 0;
+}
+
+void OutputClose(LedgerOutput *out) {
+    OutputFlush(out);
+    FreeOutputBuffer(out);
+}
+
+static void OutputText(LedgerOutput *out, const char *text, size_t len) {
+    if (OUTPUT_BUFFER_SIZE - out->len < len) OutputFlush(out);
+    memcpy(out->buf + out->len, text, len);
+    out->len += len;
+}
+
+void OutputHeader(LedgerOutput *out) {
+    OutputText(out, table_border, sizeof(table_border) - 1);
+    OutputText(out, table_heading, sizeof(table_heading) - 1);
+    OutputText(out, table_border, sizeof(table_border) - 1);
+}
+
+void OutputFooter(LedgerOutput *out) {
+    OutputText(out, table_border, sizeof(table_border) - 1);
+}
+
+// Fill one row in place; the description is cut or padded to 24 columns.
+static void FillRow(LedgerOutput *out, int timestamp, int64_t amount, const char *desc, int desc_len, int64_t balance) {
+    if (OUTPUT_BUFFER_SIZE - out->len < ROW_WIDTH) OutputFlush(out);
+
+    char *row = out->buf + out->len;
+
+    memcpy(row, row_template, ROW_WIDTH);
+    FormatDate(row + 2, timestamp, &out->dates);
+    memcpy(row + 20, desc, min(desc_len, 24));
+    FormatMoney(row + 47, amount);
+    FormatMoney(row + 64, balance);
+    out->len += ROW_WIDTH;
+}
+
+// A row for a parsed line, its description taken from data.
+void OutputRow(LedgerOutput *out, TransactionView *trans, const char *data, int64_t balance) {
+    FillRow(out, trans->timestamp, trans->amount, data + trans->desc_off, trans->desc_len, balance);
+}
+
+// A row for a stored transaction, its description taken from descs.
+void OutputTransaction(LedgerOutput *out, Transaction *trans, StringArena *descs, int64_t balance) {
+    int desc_len = 0;
+    const char *desc = ArenaString(descs, trans->desc, &desc_len);
+    FillRow(out, trans->timestamp, trans->amount, desc, desc_len, balance);
+}
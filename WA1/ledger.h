@@ -0,0 +1,197 @@
+#ifndef _LEDGER_H_
+#define _LEDGER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cs402.h"
+#include "my402list.h"
+
+#define MAX_LINE_LENGTH 1024
+#define STDIN_CHUNK_SIZE (1 << 20)
+#define MERGE_READER_SIZE (64 * 1024)  /* input buffer per merged file */
+#define MAX_LOAD_WORKERS 256
+
+#define DATE_FIELD_WIDTH 15
+#define MONEY_FIELD_WIDTH 14
+#define DATE_CACHE_SIZE 256
+#define ROW_WIDTH 81  /* one table row including its newline */
+#define OUTPUT_BUFFER_SIZE (1 << 20)
+
+#define ARENA_NO_ID 0xffffffffu
+
+#define LEDGER_BIN_MAGIC "W1LEDGER"  /* 8 bytes, no terminating NUL */
+#define LEDGER_BIN_VERSION 1
+#define LEDGER_BIN_SORTED 0x1        /* timestamps strictly increasing */
+
+#define LEDGER_INDEX_MAGIC "W1LINDEX"
+#define LEDGER_INDEX_VERSION 3
+#define LEDGER_INDEX_BLOCK 256       /* entries per prefix-sum block */
+
+// A transaction as parsed from a line; the description is a view into the
+// text it came from, by offset so a growing stdin buffer can move.
+typedef struct {
+    int timestamp;
+    int64_t amount;      // in cents, negative for withdrawals
+    size_t desc_off;
+    int desc_len;
+} TransactionView;
+
+// A transaction as kept in memory, 40 bytes.
+typedef struct {
+    My402ListElem link;  // transactions are kept in an intrusive list
+    int timestamp;
+    uint32_t desc;       // id of the description in a StringArena
+    int64_t amount;      // in cents, negative for withdrawals
+} Transaction;
+
+// Descriptions, each stored once.  An id is the offset of an entry in
+// data: a 32-bit hash of the text, its 16-bit length, then the text,
+// padded to 4 bytes.  slots is an open-addressing table of id + 1 (0 for
+// an empty slot) with num_slots a power of two.
+typedef struct {
+    char *data;
+    size_t size, capacity;
+    uint32_t *slots;
+    size_t num_slots, count;
+} StringArena;
+
+// The whole input, either mapped from the file or read from stdin.  The
+// transactions are stored in one array per load worker and their
+// descriptions in descs; both outlive the text and are freed with the input.
+typedef struct {
+    char *data;
+    size_t size;
+    int mapped;
+    Transaction *batches[MAX_LOAD_WORKERS];
+    int num_batches;
+    StringArena descs;
+} LedgerInput;
+
+// Binary ledger: this header, then num_records records, then the string
+// heap at heap_off.  Descriptions are heap_off + desc_off, not terminated.
+// Everything is in host byte order.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t flags;
+    uint64_t num_records;
+    uint64_t heap_off;
+    uint64_t heap_size;
+} LedgerBinHeader;
+
+typedef struct {
+    int64_t timestamp;
+    int64_t amount;  // in cents
+    uint32_t desc_off;
+    uint16_t desc_len;
+    uint16_t reserved;
+} LedgerBinRecord;
+
+// Index of a text ledger, kept next to it as <ledger>.idx: this header,
+// num_entries entries in timestamp order, then one int64_t per block of
+// LEDGER_INDEX_BLOCK entries holding the balance before the block.  The
+// ledger's size and mtime tell whether the index is still current; a hash
+// of all of it tells whether it was only appended to.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t block_size;
+    uint64_t num_entries;
+    uint64_t ledger_size;
+    int64_t ledger_mtime;
+    uint64_t content_hash;
+} LedgerIndexHeader;
+
+typedef struct {
+    int64_t timestamp;
+    int64_t amount;   // in cents
+    uint64_t offset;  // of the line in the ledger
+} LedgerIndexEntry;
+
+// Streams lines from a file or stdin through a fixed buffer, for modes
+// that cannot keep the whole input around.
+typedef struct {
+    int fd;
+    char *buf;
+    size_t size, start, end;
+    int eof;
+} LineReader;
+
+// Sort key for the radix sort, the timestamp with its sign bit flipped so
+// that unsigned order is timestamp order.  item is whatever the caller is
+// sorting (a Transaction or a TransactionView).
+typedef struct {
+    uint32_t key;
+    void *item;
+} SortKey;
+
+// Recently formatted dates.  Each slot holds the text for a range of
+// timestamps known to fall on one local calendar day.
+typedef struct {
+    struct {
+        int64_t lo, hi;
+        char text[DATE_FIELD_WIDTH];
+    } slot[DATE_CACHE_SIZE];
+} DateCache;
+
+// Table rows are built in buf and leave with one write() (or vmsplice()
+// when fd is a pipe) per OUTPUT_BUFFER_SIZE bytes.
+typedef struct {
+    int fd;
+    int use_vmsplice;
+    int buf_mapped;
+    char *buf;
+    size_t len;
+    DateCache dates;
+} LedgerOutput;
+
+extern int  OpenLedgerInput(LedgerInput*, const char*);
+extern void CloseLedgerInput(LedgerInput*);
+
+extern int  LineReaderOpen(LineReader*, const char*, size_t);
+extern int  LineReaderNext(LineReader*, const char**, int*);
+extern int  LineReaderPending(LineReader*);
+extern int  LineReaderIsBinaryLedger(LineReader*);
+extern void LineReaderClose(LineReader*);
+
+extern int  ParseTransaction(const char*, size_t, int, TransactionView*);
+extern void LoadTransactions(LedgerInput*, My402List*, int);
+extern void ReleaseLedgerText(LedgerInput*);
+
+extern int  ArenaInit(StringArena*);
+extern uint32_t ArenaIntern(StringArena*, const char*, int);
+extern const char *ArenaString(StringArena*, uint32_t, int*);
+extern int  ArenaMoveInto(StringArena*, StringArena*);
+extern uint32_t ArenaMovedId(StringArena*, uint32_t);
+extern void ArenaFree(StringArena*);
+
+extern int  IsBinaryLedger(LedgerInput*);
+extern const LedgerBinHeader *BinaryLedgerHeader(LedgerInput*);
+extern void LoadBinaryLedger(LedgerInput*, My402List*);
+extern void RenderBinaryLedger(LedgerInput*, LedgerOutput*);
+extern void WriteBinaryLedger(My402List*, StringArena*, const char*);
+
+extern void RenderLedgerRange(const char*, int, int, LedgerOutput*);
+extern void UpdateLedgerIndex(const char*, int, LedgerOutput*, int);
+
+extern SortKey *RadixSortKeys(SortKey*, SortKey*, int);
+extern SortKey *SortKeys(SortKey*, SortKey*, int, int, int*);
+extern void SortByTimestamp(My402List*, int);
+
+extern int64_t AddMoney(int64_t, int64_t);
+extern void FormatMoney(char*, int64_t);
+extern void DateCacheInit(DateCache*);
+extern void FormatDate(char*, int, DateCache*);
+
+extern void ExternalSortAndRender(const char*, size_t, int, LedgerOutput*);
+extern void MergeSortedLedgers(const char**, int, LedgerOutput*);
+
+extern void OutputInit(LedgerOutput*, int);
+extern void OutputHeader(LedgerOutput*);
+extern void OutputRow(LedgerOutput*, TransactionView*, const char*, int64_t);
+extern void OutputTransaction(LedgerOutput*, Transaction*, StringArena*, int64_t);
+extern void OutputFooter(LedgerOutput*);
+extern void OutputFlush(LedgerOutput*);
+extern void OutputClose(LedgerOutput*);
+
+#endif /*_LEDGER_H_*/
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "ledger.h"
+
+#define ARENA_ENTRY_HEADER 6  /* 32-bit hash, 16-bit length */
+#define ARENA_INITIAL_SIZE 4096
+#define ARENA_INITIAL_SLOTS 256
+
+static uint32_t HashText(const char *text, int len) {
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static size_t EntrySize(int len) {
+    return (ARENA_ENTRY_HEADER + (size_t)len + 3) & ~(size_t)3;
+}
+
+static uint32_t EntryHash(StringArena *arena, uint32_t id) {
+    uint32_t hash;
+    memcpy(&hash, arena->data + id, sizeof(hash));
+    return hash;
+}
+
+static int EntryLength(StringArena *arena, uint32_t id) {
+    uint16_t len;
+    memcpy(&len, arena->data + id + 4, sizeof(len));
+    return len;
+}
+
+int ArenaInit(StringArena *arena) {
+    memset(arena, 0, sizeof(*arena));
+    arena->data = (char *)malloc(ARENA_INITIAL_SIZE);
+    arena->slots = (uint32_t *)calloc(ARENA_INITIAL_SLOTS, sizeof(uint32_t));
+    if (arena->data == NULL || arena->slots == NULL) {
+        ArenaFree(arena);
+        return FALSE;
+    }
+    arena->capacity = ARENA_INITIAL_SIZE;
+    arena->num_slots = ARENA_INITIAL_SLOTS;
+    return TRUE;
+}
+
+// Double the table, keeping it at most half full.
+static int GrowSlots(StringArena *arena) {
+    size_t num_slots = 2 * arena->num_slots;
+    uint32_t *slots = (uint32_t *)calloc(num_slots, sizeof(uint32_t));
+
+    if (slots == NULL) return FALSE;
+    for (size_t i = 0; i < arena->num_slots; i++) {
+        if (arena->slots[i] == 0) continue;
+        size_t j = EntryHash(arena, arena->slots[i] - 1) & (num_slots - 1);
+        while (slots[j] != 0) j = (j + 1) & (num_slots - 1);
+        slots[j] = arena->slots[i];
+    }
+    free(arena->slots);
+    arena->slots = slots;
+    arena->num_slots = num_slots;
+    return TRUE;
+}
+
+// The id of text[0..len), added if it is not there yet.  Returns
+// ARENA_NO_ID when out of memory or past the 4 GB an id can address.
+uint32_t ArenaIntern(StringArena *arena, const char *text, int len) {
+    uint32_t hash = HashText(text, len);
+    size_t i = hash & (arena->num_slots - 1);
+
+    for (; arena->slots[i] != 0; i = (i + 1) & (arena->num_slots - 1)) {
+        uint32_t id = arena->slots[i] - 1;
+        if (EntryHash(arena, id) == hash && EntryLength(arena, id) == len &&
+                memcmp(arena->data + id + ARENA_ENTRY_HEADER, text, len) == 0) {
+            return id;
+        }
+    }
+
+    size_t size = EntrySize(len);
+    if (arena->size + size >= ARENA_NO_ID) return ARENA_NO_ID;
+    if (arena->size + size > arena->capacity) {
+        size_t capacity = max(2 * arena->capacity, arena->size + size);
+        char *data = (char *)realloc(arena->data, capacity);
+        if (data == NULL) return ARENA_NO_ID;
+        arena->data = data;
+        arena->capacity = capacity;
+    }
+    uint32_t id = (uint32_t)arena->size;
+    uint16_t len16 = (uint16_t)len;
+    memcpy(arena->data + id, &hash, sizeof(hash));
+    memcpy(arena->data + id + 4, &len16, sizeof(len16));
+    memcpy(arena->data + id + ARENA_ENTRY_HEADER, text, len);
+    arena->size += size;
+
+    arena->slots[i] = id + 1;
+    if (++arena->count * 2 > arena->num_slots && !GrowSlots(arena)) return ARENA_NO_ID;
+    return id;
+}
+
+const char *ArenaString(StringArena *arena, uint32_t id, int *len) {
+    *len = EntryLength(arena, id);
+    return arena->data + id + ARENA_ENTRY_HEADER;
+}
+
+// Intern everything in src into dst.  Each entry of src then holds its id
+// in dst where its hash was, for ArenaMovedId(); src can only be freed
+// after that.
+int ArenaMoveInto(StringArena *dst, StringArena *src) {
+    for (size_t id = 0; id < src->size; id += EntrySize(EntryLength(src, (uint32_t)id))) {
+        int len = 0;
+        const char *text = ArenaString(src, (uint32_t)id, &len);
+        uint32_t new_id = ArenaIntern(dst, text, len);
+        if (new_id == ARENA_NO_ID) return FALSE;
+        memcpy(src->data + id, &new_id, sizeof(new_id));
+    }
+    return TRUE;
+}
+
+uint32_t ArenaMovedId(StringArena *src, uint32_t id) {
+    return EntryHash(src, id);
+}
+
+void ArenaFree(StringArena *arena) {
+    free(arena->data);
+    free(arena->slots);
+    memset(arena, 0, sizeof(*arena));
+}
@@ -0,0 +1,163 @@
+/*
+ * ledgerbench: where the time goes in "warmup1 sort", one phase at a time.
+ *
+ *     ./ledgerbench [-j workers] [-o outfile] file ...
+ *     ./ledgergen -n 1000000 > big && ./ledgerbench -j 4 big
+ *
+ * parse   map the file and load its transactions (input bytes)
+ * sort    sort them by timestamp and check for duplicates (input bytes)
+ * format  render the table into memory (table bytes)
+ * output  write() the rendered table to outfile (table bytes)
+ *
+ * Rendering goes to a memfd so that formatting and writing can be timed
+ * apart.  Without -o the table is written to a temporary file that is
+ * removed afterwards; with -o it is left there to compare, so give one
+ * file at most in that case.
+ */
+
+#define _GNU_SOURCE  /* memfd_create() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "ledger.h"
+
+static double now_in_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+static void print_phase(const char *name, double ms, long rows, size_t bytes) {
+    double secs = ms / 1000.0;
+    printf("  %-8s %10.1f %14.0f %10.1f\n", name, ms, rows / secs, bytes / secs / (1 << 20));
+}
+
+static void write_all(int fd, const char *data, size_t size) {
+    size_t done = 0;
+
+    while (done < size) {
+        ssize_t n = write(fd, data + done, min(size - done, (size_t)OUTPUT_BUFFER_SIZE));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Error: write failed");
+            exit(1);
+        }
+        done += (size_t)n;
+    }
+}
+
+static void bench_file(const char *path, int num_workers, const char *out_path) {
+    My402List list;
+    LedgerInput input;
+    LedgerOutput output;
+    double start = 0.0, parse_ms = 0.0, sort_ms = 0.0, format_ms = 0.0, output_ms = 0.0;
+
+    if (!My402ListInitIntrusive(&list)) {
+        fprintf(stderr, "Error: Could not initialize list\n");
+        exit(1);
+    }
+
+    start = now_in_ms();
+    if (!OpenLedgerInput(&input, path)) {
+        fprintf(stderr, "Error: Could not open input file: %s\n", path);
+        exit(1);
+    }
+    size_t input_size = input.size;
+    if (IsBinaryLedger(&input)) {
+        LoadBinaryLedger(&input, &list);
+    } else {
+        LoadTransactions(&input, &list, num_workers);
+    }
+    ReleaseLedgerText(&input);
+    parse_ms = now_in_ms() - start;
+    long rows = My402ListLength(&list);
+
+    start = now_in_ms();
+    SortByTimestamp(&list, num_workers);
+    sort_ms = now_in_ms() - start;
+
+    int mem_fd = memfd_create("ledgerbench", 0);
+    if (mem_fd < 0) {
+        perror("Error: memfd_create failed");
+        exit(1);
+    }
+    start = now_in_ms();
+    OutputInit(&output, mem_fd);
+    OutputHeader(&output);
+    int64_t balance = 0;
+    My402ListElem *elem = NULL;
+    for (elem = My402ListFirst(&list); elem != NULL; elem = My402ListNext(&list, elem)) {
+        Transaction *trans = My402ListEntry(elem, Transaction, link);
+        balance = AddMoney(balance, trans->amount);
+        OutputTransaction(&output, trans, &input.descs, balance);
+    }
+    OutputFooter(&output);
+    OutputClose(&output);
+    format_ms = now_in_ms() - start;
+
+    size_t table_size = (size_t)(rows + 4) * ROW_WIDTH;
+    char *table = (char *)mmap(NULL, table_size, PROT_READ, MAP_SHARED, mem_fd, 0);
+    if (table == MAP_FAILED) {
+        perror("Error: mmap failed");
+        exit(1);
+    }
+
+    char tmp_path[] = "/tmp/ledgerbench.XXXXXX";
+    int out_fd = out_path != NULL ? open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : mkstemp(tmp_path);
+    if (out_fd < 0) {
+        fprintf(stderr, "Error: Could not open output file: %s\n", out_path != NULL ? out_path : tmp_path);
+        exit(1);
+    }
+    start = now_in_ms();
+    write_all(out_fd, table, table_size);
+    output_ms = now_in_ms() - start;
+    close(out_fd);
+    if (out_path == NULL) unlink(tmp_path);
+
+    printf("%s: %ld rows, %.1f MB in, %.1f MB out, %d workers\n", path, rows,
+           input_size / (double)(1 << 20), table_size / (double)(1 << 20), num_workers);
+    printf("  %-8s %10s %14s %10s\n", "phase", "ms", "rows/s", "MB/s");
+    print_phase("parse", parse_ms, rows, input_size);
+    print_phase("sort", sort_ms, rows, input_size);
+    print_phase("format", format_ms, rows, table_size);
+    print_phase("output", output_ms, rows, table_size);
+    print_phase("total", parse_ms + sort_ms + format_ms + output_ms, rows, input_size);
+
+    munmap(table, table_size);
+    close(mem_fd);
+    My402ListUnlinkAll(&list);
+    CloseLedgerInput(&input);
+}
+
+int main(int argc, char *argv[]) {
+    int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char *out_path = NULL, *files[argc];
+    int num_files = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            num_workers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else {
+            files[num_files++] = argv[i];
+        }
+    }
+    if (num_files == 0 || num_workers <= 0 || (out_path != NULL && num_files > 1)) {
+        fprintf(stderr, "Usage: %s [-j workers] [-o outfile] file ...\n", argv[0]);
+        return 1;
+    }
+
+    for (int i = 0; i < num_files; i++) {
+        bench_file(files[i], num_workers, out_path);
+    }
+    return 0;
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "ledger.h"
+
+#define BIN_WRITE_BUFFER_SIZE (1 << 20)
+
+int IsBinaryLedger(LedgerInput *input) {
+    return input->size >= sizeof(LedgerBinHeader) && memcmp(input->data, LEDGER_BIN_MAGIC, 8) == 0;
+}
+
+static void CorruptLedger() {
+    fprintf(stderr, "Error: Corrupt binary ledger\n");
+    exit(EXIT_FAILURE);
+}
+
+// The header, once it is known to describe what is actually in the input.
+const LedgerBinHeader *BinaryLedgerHeader(LedgerInput *input) {
+    const LedgerBinHeader *header = (const LedgerBinHeader *)input->data;
+
+    if (header->version != LEDGER_BIN_VERSION) {
+        fprintf(stderr, "Error: Unsupported binary ledger version %u\n", header->version);
+        exit(EXIT_FAILURE);
+    }
+    if (header->num_records > (input->size - sizeof(LedgerBinHeader)) / sizeof(LedgerBinRecord) ||
+            header->num_records > 0x7fffffff ||
+            header->heap_off < sizeof(LedgerBinHeader) + header->num_records * sizeof(LedgerBinRecord) ||
+            header->heap_off > input->size || header->heap_size > input->size - header->heap_off) {
+        CorruptLedger();
+    }
+    return header;
+}
+
+static const LedgerBinRecord *BinaryRecords(LedgerInput *input) {
+    return (const LedgerBinRecord *)(input->data + sizeof(LedgerBinHeader));
+}
+
+// A record as a TransactionView whose description is in the input.
+static void RecordToView(const LedgerBinHeader *header, const LedgerBinRecord *rec, TransactionView *trans) {
+    if ((uint64_t)rec->desc_off + rec->desc_len > header->heap_size) CorruptLedger();
+    trans->timestamp = (int)rec->timestamp;
+    trans->amount = rec->amount;
+    trans->desc_off = (size_t)(header->heap_off + rec->desc_off);
+    trans->desc_len = rec->desc_len;
+}
+
+static void OutOfMemory() {
+    fprintf(stderr, "Error: Out of memory reading input\n");
+    exit(EXIT_FAILURE);
+}
+
+// Turn the records into Transactions, for when they still have to be sorted.
+void LoadBinaryLedger(LedgerInput *input, My402List *pList) {
+    const LedgerBinHeader *header = BinaryLedgerHeader(input);
+    const LedgerBinRecord *records = BinaryRecords(input);
+    TransactionView view;
+    int n = (int)header->num_records;
+
+    Transaction *trans = (Transaction *)malloc(max(n, 1) * sizeof(Transaction));
+    if (trans == NULL || !ArenaInit(&input->descs)) OutOfMemory();
+    for (int i = 0; i < n; i++) {
+        RecordToView(header, &records[i], &view);
+        trans[i].timestamp = view.timestamp;
+        trans[i].amount = view.amount;
+        trans[i].desc = ArenaIntern(&input->descs, input->data + view.desc_off, view.desc_len);
+        if (trans[i].desc == ARENA_NO_ID) OutOfMemory();
+        My402ListAppendElem(pList, &trans[i].link);
+    }
+    input->batches[input->num_batches++] = trans;
+}
+
+// Print the table straight from the mapped records, in file order.
+void RenderBinaryLedger(LedgerInput *input, LedgerOutput *out) {
+    const LedgerBinHeader *header = BinaryLedgerHeader(input);
+    const LedgerBinRecord *records = BinaryRecords(input);
+    TransactionView trans;
+    int64_t balance = 0;
+
+    OutputHeader(out);
+    for (uint64_t i = 0; i < header->num_records; i++) {
+        RecordToView(header, &records[i], &trans);
+        balance = AddMoney(balance, trans.amount);
+        OutputRow(out, &trans, input->data, balance);
+    }
+    OutputFooter(out);
+}
+
+static void WriteOrDie(const void *data, size_t size, FILE *fp) {
+    if (size > 0 && fwrite(data, size, 1, fp) != 1) {
+        perror("Error: Could not write binary ledger");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Write the transactions in pList, in list order, to path.  The sorted flag
+// is set when their timestamps are strictly increasing.  The string heap is
+// the arena as it is, so each distinct description is stored once (between
+// arena bookkeeping that no record points at).
+void WriteBinaryLedger(My402List *pList, StringArena *descs, const char *path) {
+    LedgerBinHeader header;
+    LedgerBinRecord rec;
+    My402ListElem *elem = NULL;
+    int sorted = TRUE, have_last = FALSE, last = 0;
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Could not open output file: %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    setvbuf(fp, NULL, _IOFBF, BIN_WRITE_BUFFER_SIZE);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LEDGER_BIN_MAGIC, 8);
+    header.version = LEDGER_BIN_VERSION;
+    for (elem = My402ListFirst(pList); elem != NULL; elem = My402ListNext(pList, elem)) {
+        Transaction *trans = My402ListEntry(elem, Transaction, link);
+        if (have_last && trans->timestamp <= last) sorted = FALSE;
+        last = trans->timestamp;
+        have_last = TRUE;
+        header.num_records++;
+    }
+    header.flags = sorted ? LEDGER_BIN_SORTED : 0;
+    header.heap_off = sizeof(LedgerBinHeader) + header.num_records * sizeof(LedgerBinRecord);
+    header.heap_size = descs->size;
+    WriteOrDie(&header, sizeof(header), fp);
+
+    memset(&rec, 0, sizeof(rec));
+    for (elem = My402ListFirst(pList); elem != NULL; elem = My402ListNext(pList, elem)) {
+        Transaction *trans = My402ListEntry(elem, Transaction, link);
+        int desc_len = 0;
+        const char *desc = ArenaString(descs, trans->desc, &desc_len);
+        rec.timestamp = trans->timestamp;
+        rec.amount = trans->amount;
+        rec.desc_off = (uint32_t)(desc - descs->data);
+        rec.desc_len = (uint16_t)desc_len;
+        WriteOrDie(&rec, sizeof(rec), fp);
+    }
+    WriteOrDie(descs->data, descs->size, fp);
+
+    if (fclose(fp) != 0) {
+        perror("Error: Could not write binary ledger");
+        exit(EXIT_FAILURE);
+    }
+}
@@ -0,0 +1,183 @@
+/*
+ * ledgergen: write a synthetic ledger of any size to stdout, for the
+ * benchmarks and for testing warmup1 on inputs bigger than w1data.
+ *
+ *     ./ledgergen [-n rows] [-seed seed] [-order random|sorted|reverse|nearly]
+ *                 [-dup count] [-bad count] [-uniq]
+ *     ./ledgergen -n 1000000 > big
+ *     ./ledgergen -n 100000 -order nearly -dup 1% > dups
+ *
+ * Timestamps are unique unless -dup is given, in which case that many rows
+ * reuse the timestamp of another row.  -bad replaces that many rows with
+ * lines warmup1 must reject.  A count ending in '%' is a share of the rows.
+ * -uniq makes every description distinct instead of drawing them from a
+ * small set, which is the worst case for interning them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "ledger.h"
+
+#define GEN_FIRST_TIMESTAMP 1000000000
+#define GEN_LAST_TIMESTAMP 2000000000
+#define GEN_NEARLY_SWAPS 100  /* one neighbour swap per this many rows */
+
+enum { ORDER_RANDOM, ORDER_SORTED, ORDER_REVERSE, ORDER_NEARLY };
+
+static const char *descriptions[] = {
+    "Grocery", "Phone bill", "Royalty check", "Rent", "Paycheck",
+    "Gas", "Coffee", "Movie tickets", "Book store", "Insurance premium",
+    "Electric bill", "Restaurant", "Gym membership", "Refund", "Parking",
+    "Dividend",
+};
+
+// xorshift, so a seed gives the same ledger everywhere
+static uint32_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return (uint32_t)(x >> 32);
+}
+
+static int random_below(uint64_t *state, int n) {
+    return (int)(((uint64_t)next_random(state) * (uint64_t)n) >> 32);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-n rows] [-seed seed] [-order random|sorted|reverse|nearly]\n"
+                    "       [-dup count] [-bad count] [-uniq]\n", prog);
+    exit(1);
+}
+
+// a count, or with a trailing '%' that share of n rows
+static int parse_count(const char *arg, int n, const char *prog) {
+    char *end = NULL;
+    double v = strtod(arg, &end);
+
+    if (end == arg || v < 0) usage(prog);
+    if (*end == '%' && end[1] == '\0') v = v * n / 100.0;
+    else if (*end != '\0') usage(prog);
+    return (int)min(v, (double)n);
+}
+
+static void write_malformed(int kind, int timestamp) {
+    switch (kind) {
+    case 0: printf("*\t%d\t12.34\tBad sign\n", timestamp); break;
+    case 1: printf("+\t%d\t12.34\n", timestamp); break;
+    case 2: printf("-\tnot-a-time\t12.34\tBad timestamp\n"); break;
+    case 3: printf("+\t%d\tlots\tBad amount\n", timestamp); break;
+    default: printf("\n"); break;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int n = 1000000, num_dups = 0, num_bad = 0, order = ORDER_RANDOM, uniq = FALSE;
+    const char *dup_arg = NULL, *bad_arg = NULL;
+    uint64_t seed = 402;
+    int i = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            n = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            seed = (uint64_t)atol(argv[++i]) | 1;
+        } else if (strcmp(argv[i], "-order") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "random") == 0) order = ORDER_RANDOM;
+            else if (strcmp(name, "sorted") == 0) order = ORDER_SORTED;
+            else if (strcmp(name, "reverse") == 0) order = ORDER_REVERSE;
+            else if (strcmp(name, "nearly") == 0) order = ORDER_NEARLY;
+            else usage(argv[0]);
+        } else if (strcmp(argv[i], "-dup") == 0 && i + 1 < argc) {
+            dup_arg = argv[++i];
+        } else if (strcmp(argv[i], "-bad") == 0 && i + 1 < argc) {
+            bad_arg = argv[++i];
+        } else if (strcmp(argv[i], "-uniq") == 0) {
+            uniq = TRUE;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (n <= 0 || n > GEN_LAST_TIMESTAMP - GEN_FIRST_TIMESTAMP) {
+        fprintf(stderr, "Error: -n must be between 1 and %d\n", GEN_LAST_TIMESTAMP - GEN_FIRST_TIMESTAMP);
+        return 1;
+    }
+    if (dup_arg != NULL) num_dups = parse_count(dup_arg, n, argv[0]);
+    if (bad_arg != NULL) num_bad = parse_count(bad_arg, n, argv[0]);
+
+    int *timestamps = (int *)malloc((size_t)n * sizeof(int));
+    unsigned char *bad = (unsigned char *)calloc((size_t)n, 1);
+    if (timestamps == NULL || bad == NULL) {
+        fprintf(stderr, "Error: Could not allocate %d rows\n", n);
+        return 1;
+    }
+
+    // increasing and unique: each row gets its own slot of gap seconds
+    int gap = (GEN_LAST_TIMESTAMP - GEN_FIRST_TIMESTAMP) / n;
+    for (i = 0; i < n; i++) {
+        timestamps[i] = GEN_FIRST_TIMESTAMP + i * gap + random_below(&seed, gap);
+    }
+
+    switch (order) {
+    case ORDER_REVERSE:
+        for (i = 0; i < n / 2; i++) {
+            int t = timestamps[i];
+            timestamps[i] = timestamps[n - 1 - i];
+            timestamps[n - 1 - i] = t;
+        }
+        break;
+    case ORDER_NEARLY:
+        for (int k = 0; k < n / GEN_NEARLY_SWAPS; k++) {
+            int j = random_below(&seed, n - 1);
+            int t = timestamps[j];
+            timestamps[j] = timestamps[j + 1];
+            timestamps[j + 1] = t;
+        }
+        break;
+    case ORDER_RANDOM:
+        for (i = n - 1; i > 0; i--) {
+            int j = random_below(&seed, i + 1);
+            int t = timestamps[i];
+            timestamps[i] = timestamps[j];
+            timestamps[j] = t;
+        }
+        break;
+    }
+
+    // copy from a neighbour when there is one, so a nearly sorted
+    // ledger stays nearly sorted
+    for (int k = 0; k < num_dups && n > 1; k++) {
+        int j = random_below(&seed, n);
+        timestamps[j] = timestamps[j > 0 ? j - 1 : j + 1];
+    }
+    for (int k = 0; k < num_bad; k++) {
+        int j = random_below(&seed, n);
+        while (bad[j]) j = (j + 1) % n;
+        bad[j] = TRUE;
+    }
+
+    int num_descriptions = (int)(sizeof(descriptions) / sizeof(descriptions[0]));
+    for (i = 0; i < n; i++) {
+        if (bad[i]) {
+            write_malformed(random_below(&seed, 5), timestamps[i]);
+            continue;
+        }
+        uint32_t cents = next_random(&seed) % 500000;
+        const char *desc = descriptions[random_below(&seed, num_descriptions)];
+        char sign = (next_random(&seed) & 1) ? '+' : '-';
+        if (uniq) {
+            printf("%c\t%d\t%u.%02u\t%s #%d\n", sign, timestamps[i], cents / 100, cents % 100, desc, i);
+        } else {
+            printf("%c\t%d\t%u.%02u\t%s\n", sign, timestamps[i], cents / 100, cents % 100, desc);
+        }
+    }
+
+    free(timestamps);
+    free(bad);
+    return ferror(stdout) ? 1 : 0;
+}
@@ -0,0 +1,384 @@
+#define _GNU_SOURCE  /* memrchr() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "ledger.h"
+
+#define INDEX_WRITE_BUFFER_SIZE (1 << 20)
+
+static void IndexPath(char *buf, const char *ledger_path, const char *suffix) {
+    if (snprintf(buf, MAXPATHLENGTH, "%s%s", ledger_path, suffix) >= MAXPATHLENGTH) {
+        fprintf(stderr, "Error: Path too long: %s\n", ledger_path);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Size and modification time (in ns) of the ledger, to tell a stale index.
+static void LedgerStamp(const char *ledger_path, uint64_t *size, int64_t *mtime) {
+    struct stat st;
+
+    if (stat(ledger_path, &st) != 0) {
+        fprintf(stderr, "Error: Could not open input file: %s\n", ledger_path);
+        exit(EXIT_FAILURE);
+    }
+    *size = (uint64_t)st.st_size;
+    *mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+// FNV-1a of data[0..size).  One pass over the text, still far cheaper
+// than parsing and sorting it again.
+static uint64_t ContentHash(const char *data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Offset of the line a transaction was parsed from: it starts right after
+// the newline before its description.
+static uint64_t LineStart(const char *data, TransactionView *trans) {
+    const char *nl = (const char *)memrchr(data, '\n', trans->desc_off);
+    return (nl != NULL) ? (uint64_t)(nl - data) + 1 : 0;
+}
+
+static void WriteOrDie(const void *data, size_t size, FILE *fp) {
+    if (size > 0 && fwrite(data, size, 1, fp) != 1) {
+        perror("Error: Could not write index file");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static FILE *CreateIndexFile(const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Error: Could not open index file: %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    setvbuf(fp, NULL, _IOFBF, INDEX_WRITE_BUFFER_SIZE);
+    return fp;
+}
+
+static void CloseIndexFile(FILE *fp) {
+    if (fclose(fp) != 0) {
+        perror("Error: Could not write index file");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void InitIndexHeader(LedgerIndexHeader *header, const char *ledger_path, LedgerInput *input, uint64_t n) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, LEDGER_INDEX_MAGIC, 8);
+    header->version = LEDGER_INDEX_VERSION;
+    header->block_size = LEDGER_INDEX_BLOCK;
+    header->num_entries = n;
+    LedgerStamp(ledger_path, &header->ledger_size, &header->ledger_mtime);
+    if (header->ledger_size != input->size) {
+        fprintf(stderr, "Error: %s changed while it was being indexed\n", ledger_path);
+        exit(EXIT_FAILURE);
+    }
+    header->content_hash = ContentHash(input->data, input->size);
+}
+
+static int64_t *AllocBlocks(uint64_t n) {
+    int64_t *blocks = (int64_t *)malloc((n / LEDGER_INDEX_BLOCK + 1) * sizeof(int64_t));
+    if (blocks == NULL) {
+        fprintf(stderr, "Error: Out of memory building index\n");
+        exit(EXIT_FAILURE);
+    }
+    return blocks;
+}
+
+static size_t BlocksSize(uint64_t n) {
+    return (size_t)((n + LEDGER_INDEX_BLOCK - 1) / LEDGER_INDEX_BLOCK) * sizeof(int64_t);
+}
+
+static void BadIndex(const char *path, const char *why) {
+    fprintf(stderr, "Error: %s %s, rebuild it with \"warmup1 index\"\n", path, why);
+    exit(EXIT_FAILURE);
+}
+
+// NULL if index holds a well-formed ledger index, otherwise what is wrong.
+static const char *CheckIndex(LedgerInput *index) {
+    const LedgerIndexHeader *header = (const LedgerIndexHeader *)index->data;
+
+    if (index->size < sizeof(LedgerIndexHeader) || memcmp(header->magic, LEDGER_INDEX_MAGIC, 8) != 0 ||
+            header->version != LEDGER_INDEX_VERSION || header->block_size != LEDGER_INDEX_BLOCK) {
+        return "is not a ledger index";
+    }
+    uint64_t n = header->num_entries;
+    if (n > (index->size - sizeof(LedgerIndexHeader)) / sizeof(LedgerIndexEntry) ||
+            index->size != sizeof(LedgerIndexHeader) + n * sizeof(LedgerIndexEntry) + BlocksSize(n)) {
+        return "is truncated";
+    }
+    return NULL;
+}
+
+static const LedgerIndexEntry *IndexEntries(LedgerInput *index) {
+    return (const LedgerIndexEntry *)(index->data + sizeof(LedgerIndexHeader));
+}
+
+static const int64_t *IndexBlocks(LedgerInput *index) {
+    const LedgerIndexHeader *header = (const LedgerIndexHeader *)index->data;
+    return (const int64_t *)(IndexEntries(index) + header->num_entries);
+}
+
+// First entry with a timestamp of at least from.
+static uint64_t LowerBound(const LedgerIndexEntry *entries, uint64_t n, int64_t from) {
+    uint64_t lo = 0, hi = n;
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if (entries[mid].timestamp < from) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Balance before entry i: the prefix sum of its block plus the amounts of
+// the entries ahead of it in the block.
+static int64_t BalanceBefore(LedgerInput *index, uint64_t i) {
+    const LedgerIndexEntry *entries = IndexEntries(index);
+    const LedgerIndexHeader *header = (const LedgerIndexHeader *)index->data;
+    int64_t balance = 0;
+
+    if (header->num_entries == 0) return 0;
+    if (i == header->num_entries) {
+        // the balance after the last entry
+        return AddMoney(BalanceBefore(index, i - 1), entries[i - 1].amount);
+    }
+    balance = IndexBlocks(index)[i / LEDGER_INDEX_BLOCK];
+    for (uint64_t j = i - i % LEDGER_INDEX_BLOCK; j < i; j++) {
+        balance = AddMoney(balance, entries[j].amount);
+    }
+    return balance;
+}
+
+// Parse the line at offset off of the ledger, as recorded in an index entry.
+static void ReadIndexedLine(LedgerInput *ledger, const LedgerIndexEntry *entry, const char *path, TransactionView *trans) {
+    size_t off = (size_t)entry->offset;
+    const char *eol = NULL;
+
+    if (off < ledger->size) eol = (const char *)memchr(ledger->data + off, '\n', ledger->size - off);
+    size_t len = (eol != NULL ? (size_t)(eol - ledger->data) : ledger->size) - off;
+    if (off >= ledger->size || len >= MAX_LINE_LENGTH - 1 ||
+            !ParseTransaction(ledger->data, off, (int)len, trans) || trans->timestamp != entry->timestamp) {
+        BadIndex(path, "does not match the ledger");
+    }
+}
+
+// Print the rows of the sorted report with timestamps in [from, to].  The
+// index finds the first one and the balance before it, so nothing in the
+// ledger before the window is read.
+void RenderLedgerRange(const char *ledger_path, int from, int to, LedgerOutput *out) {
+    char path[MAXPATHLENGTH];
+    LedgerInput index, ledger;
+    uint64_t ledger_size = 0;
+    int64_t ledger_mtime = 0;
+    const char *why = NULL;
+
+    IndexPath(path, ledger_path, ".idx");
+    if (!OpenLedgerInput(&index, path)) {
+        fprintf(stderr, "Error: Could not open index file: %s, build it with \"warmup1 index\"\n", path);
+        exit(EXIT_FAILURE);
+    }
+    if ((why = CheckIndex(&index)) != NULL) BadIndex(path, why);
+    const LedgerIndexHeader *header = (const LedgerIndexHeader *)index.data;
+    LedgerStamp(ledger_path, &ledger_size, &ledger_mtime);
+    if (ledger_size != header->ledger_size || ledger_mtime != header->ledger_mtime) {
+        BadIndex(path, "is out of date");
+    }
+    if (!OpenLedgerInput(&ledger, ledger_path)) {
+        fprintf(stderr, "Error: Could not open input file: %s\n", ledger_path);
+        exit(EXIT_FAILURE);
+    }
+
+    const LedgerIndexEntry *entries = IndexEntries(&index);
+    uint64_t n = header->num_entries;
+    uint64_t i = LowerBound(entries, n, from);
+    int64_t balance = BalanceBefore(&index, i);
+
+    OutputHeader(out);
+    for (; i < n && entries[i].timestamp <= to; i++) {
+        TransactionView trans;
+        ReadIndexedLine(&ledger, &entries[i], path, &trans);
+        balance = AddMoney(balance, trans.amount);
+        OutputRow(out, &trans, ledger.data, balance);
+    }
+    OutputFooter(out);
+
+    CloseLedgerInput(&ledger);
+    CloseLedgerInput(&index);
+}
+
+// Parse ledger->data[start..size), the part appended since the checkpoint.
+static TransactionView *ParseAppended(LedgerInput *ledger, size_t start, int *num_trans) {
+    int n = 0, capacity = 1024;
+    TransactionView *trans = (TransactionView *)malloc(capacity * sizeof(TransactionView));
+    size_t pos = start;
+
+    while (trans != NULL && pos < ledger->size) {
+        const char *eol = (const char *)memchr(ledger->data + pos, '\n', ledger->size - pos);
+        size_t len = (eol != NULL ? (size_t)(eol - ledger->data) : ledger->size) - pos;
+
+        if (len >= MAX_LINE_LENGTH - 1) {
+            fprintf(stderr, "Error: Line exceeds 1024 characters\n");
+            exit(EXIT_FAILURE);
+        }
+        if (n == capacity) {
+            capacity *= 2;
+            TransactionView *grown = (TransactionView *)realloc(trans, capacity * sizeof(TransactionView));
+            if (grown == NULL) free(trans);
+            trans = grown;
+            if (trans == NULL) break;
+        }
+        if (!ParseTransaction(ledger->data, pos, (int)len, &trans[n])) {
+            fprintf(stderr, "Error: malformed line\n");
+            exit(EXIT_FAILURE);
+        }
+        n++;
+        pos += len + 1;
+    }
+    if (trans == NULL) {
+        fprintf(stderr, "Error: Out of memory reading input\n");
+        exit(EXIT_FAILURE);
+    }
+    *num_trans = n;
+    return trans;
+}
+
+// In the merge of the checkpointed entries old[i..n) with the sorted new
+// transactions sorted[j..m), whether the next one comes from old.
+static int TakeOld(const LedgerIndexEntry *old, uint64_t i, uint64_t n, SortKey *sorted, int j, int m) {
+    return j >= m || (i < n && old[i].timestamp < ((TransactionView *)sorted[j].item)->timestamp);
+}
+
+// Bring <ledger_path>.idx up to date with a ledger that has only been
+// appended to since the index was written, and print the sorted report
+// from the first row that changed.  The new lines are parsed and sorted on
+// their own, then merged into the sorted entries from where the earliest
+// of them lands; entries and balances before that point are reused as
+// they are.  If there is no usable index (or the ledger was rewritten),
+// the checkpoint is empty, which makes this a full sort that prints every
+// row and writes a new index; rebuild asks for that in any case.  With out
+// NULL only the index is written.
+void UpdateLedgerIndex(const char *ledger_path, int num_workers, LedgerOutput *out, int rebuild) {
+    char path[MAXPATHLENGTH], new_path[MAXPATHLENGTH];
+    LedgerInput index, ledger;
+    LedgerIndexHeader header;
+    LedgerIndexEntry entry;
+    int have_index = FALSE;
+    int m = 0, j = 0, dup = -1;
+    uint64_t n = 0, p = 0, i = 0;
+
+    if (!OpenLedgerInput(&ledger, ledger_path)) {
+        fprintf(stderr, "Error: Could not open input file: %s\n", ledger_path);
+        exit(EXIT_FAILURE);
+    }
+    if (IsBinaryLedger(&ledger)) {
+        fprintf(stderr, "Error: Only text ledgers can be indexed\n");
+        exit(EXIT_FAILURE);
+    }
+    IndexPath(path, ledger_path, ".idx");
+    IndexPath(new_path, ledger_path, ".idx.new");
+    if (!rebuild && OpenLedgerInput(&index, path)) {
+        const LedgerIndexHeader *old = (const LedgerIndexHeader *)index.data;
+        // appended to only: the old contents end with a complete line and
+        // are unchanged, an edit anywhere in them means a full rebuild
+        have_index = CheckIndex(&index) == NULL && old->ledger_size <= ledger.size &&
+                (old->ledger_size == 0 || ledger.data[old->ledger_size - 1] == '\n') &&
+                ContentHash(ledger.data, (size_t)old->ledger_size) == old->content_hash;
+        if (!have_index) CloseLedgerInput(&index);
+    }
+    const LedgerIndexHeader *old_header = have_index ? (const LedgerIndexHeader *)index.data : NULL;
+    const LedgerIndexEntry *old = have_index ? IndexEntries(&index) : NULL;
+    n = have_index ? old_header->num_entries : 0;
+
+    TransactionView *trans = ParseAppended(&ledger, have_index ? (size_t)old_header->ledger_size : 0, &m);
+    SortKey *keys = (SortKey *)malloc((size_t)max(m, 1) * sizeof(SortKey));
+    SortKey *tmp = (SortKey *)malloc((size_t)max(m, 1) * sizeof(SortKey));
+    if (keys == NULL || tmp == NULL) {
+        fprintf(stderr, "Error: Out of memory reading input\n");
+        exit(EXIT_FAILURE);
+    }
+    for (j = 0; j < m; j++) {
+        keys[j].item = &trans[j];
+        keys[j].key = (uint32_t)trans[j].timestamp ^ 0x80000000u;
+    }
+    SortKey *sorted = SortKeys(keys, tmp, m, num_workers, &dup);
+    if (dup >= 0) {
+        fprintf(stderr, "Error: Duplicate timestamp found: %d\n", ((TransactionView *)sorted[dup].item)->timestamp);
+        exit(EXIT_FAILURE);
+    }
+
+    // everything before the earliest new timestamp stays where it is
+    p = (m > 0) ? LowerBound(old, n, ((TransactionView *)sorted[0].item)->timestamp) : n;
+
+    // a new timestamp that is already in the ledger is found before anything
+    // is printed or written
+    for (i = p, j = 0; i < n && j < m; ) {
+        if (old[i].timestamp == ((TransactionView *)sorted[j].item)->timestamp) {
+            fprintf(stderr, "Error: Duplicate timestamp found: %d\n", ((TransactionView *)sorted[j].item)->timestamp);
+            exit(EXIT_FAILURE);
+        }
+        if (TakeOld(old, i, n, sorted, j, m)) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+
+    InitIndexHeader(&header, ledger_path, &ledger, n + (uint64_t)m);
+    int64_t *blocks = AllocBlocks(header.num_entries);
+    int64_t balance = have_index ? BalanceBefore(&index, p) : 0;
+    if (p > 0) memcpy(blocks, IndexBlocks(&index), (size_t)((p - 1) / LEDGER_INDEX_BLOCK + 1) * sizeof(int64_t));
+
+    FILE *fp = CreateIndexFile(new_path);
+    WriteOrDie(&header, sizeof(header), fp);
+    WriteOrDie(old, (size_t)p * sizeof(LedgerIndexEntry), fp);
+
+    if (out != NULL) OutputHeader(out);
+    for (i = p, j = 0; i < n || j < m; ) {
+        uint64_t pos = i + (uint64_t)j;
+        TransactionView merged;
+
+        if (TakeOld(old, i, n, sorted, j, m)) {
+            // only needed for the report, the entry already has the rest
+            if (out != NULL) ReadIndexedLine(&ledger, &old[i], path, &merged);
+            merged.amount = old[i].amount;
+            entry = old[i++];
+        } else {
+            merged = *(TransactionView *)sorted[j++].item;
+            entry.timestamp = merged.timestamp;
+            entry.amount = merged.amount;
+            entry.offset = LineStart(ledger.data, &merged);
+        }
+        if (pos % LEDGER_INDEX_BLOCK == 0) blocks[pos / LEDGER_INDEX_BLOCK] = balance;
+        WriteOrDie(&entry, sizeof(entry), fp);
+        balance = AddMoney(balance, merged.amount);
+        if (out != NULL) OutputRow(out, &merged, ledger.data, balance);
+    }
+    if (out != NULL) OutputFooter(out);
+
+    WriteOrDie(blocks, BlocksSize(header.num_entries), fp);
+    CloseIndexFile(fp);
+    if (rename(new_path, path) != 0) {
+        perror("Error: Could not replace index file");
+        exit(EXIT_FAILURE);
+    }
+
+    free(blocks);
+    free(keys);
+    free(tmp);
+    free(trans);
+    if (have_index) CloseLedgerInput(&index);
+    CloseLedgerInput(&ledger);
+}
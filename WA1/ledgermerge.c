@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "ledger.h"
+
+// The next unmerged line of one input file.
+typedef struct {
+    const char *path;
+    LineReader reader;
+    const char *line;
+    TransactionView trans;
+} MergeInput;
+
+// The rows merged so far are written out before the error.
+static void DuplicateError(LedgerOutput *out, int timestamp) {
+    OutputFlush(out);
+    fprintf(stderr, "Error: Duplicate timestamp found: %d\n", timestamp);
+    exit(EXIT_FAILURE);
+}
+
+// Move to the next line of input; FALSE at the end of the file.
+static int Advance(MergeInput *input) {
+    int len = 0;
+
+    if (!LineReaderNext(&input->reader, &input->line, &len)) return FALSE;
+    if (!ParseTransaction(input->line, 0, len, &input->trans)) {
+        fprintf(stderr, "Error: malformed line\n");
+        exit(EXIT_FAILURE);
+    }
+    return TRUE;
+}
+
+static void SiftDown(MergeInput **heap, int size, int i) {
+    MergeInput *input = heap[i];
+
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= size) break;
+        if (child + 1 < size && heap[child + 1]->trans.timestamp < heap[child]->trans.timestamp) child++;
+        if (heap[child]->trans.timestamp >= input->trans.timestamp) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = input;
+}
+
+// Render the merge of num_paths ledgers that are each sorted by timestamp,
+// without sorting anything: a heap of one line per file picks the next row,
+// so memory is a line buffer per file whatever their sizes.  Rows go out as
+// they are merged, so on a duplicate timestamp (or a file that turns out
+// not to be sorted) the rows before it have already been written.
+void MergeSortedLedgers(const char **paths, int num_paths, LedgerOutput *out) {
+    MergeInput *inputs = (MergeInput *)malloc((size_t)max(num_paths, 1) * sizeof(MergeInput));
+    MergeInput **heap = (MergeInput **)malloc((size_t)max(num_paths, 1) * sizeof(MergeInput *));
+    int heap_size = 0, have_last = FALSE, last = 0, i = 0;
+    int64_t balance = 0;
+
+    if (inputs == NULL || heap == NULL) {
+        fprintf(stderr, "Error: Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < num_paths; i++) {
+        inputs[i].path = paths[i];
+        if (!LineReaderOpen(&inputs[i].reader, paths[i], MERGE_READER_SIZE)) {
+            fprintf(stderr, "Error: Could not open input file: %s\n", paths[i]);
+            exit(EXIT_FAILURE);
+        }
+        if (LineReaderIsBinaryLedger(&inputs[i].reader)) {
+            fprintf(stderr, "Error: binary ledger not supported by merge: %s\n", paths[i]);
+            exit(EXIT_FAILURE);
+        }
+        if (Advance(&inputs[i])) heap[heap_size++] = &inputs[i];
+    }
+    for (i = heap_size / 2 - 1; i >= 0; i--) {
+        SiftDown(heap, heap_size, i);
+    }
+
+    OutputHeader(out);
+    while (heap_size > 0) {
+        MergeInput *input = heap[0];
+        int timestamp = input->trans.timestamp;
+
+        if (have_last && timestamp == last) DuplicateError(out, timestamp);
+        last = timestamp;
+        have_last = TRUE;
+        balance = AddMoney(balance, input->trans.amount);
+        OutputRow(out, &input->trans, input->line, balance);
+
+        if (!Advance(input)) {
+            heap[0] = heap[--heap_size];
+        } else if (input->trans.timestamp == timestamp) {
+            DuplicateError(out, timestamp);
+        } else if (input->trans.timestamp < timestamp) {
+            OutputFlush(out);
+            fprintf(stderr, "Error: %s is not sorted by timestamp\n", input->path);
+            exit(EXIT_FAILURE);
+        }
+        if (heap_size > 0) SiftDown(heap, heap_size, 0);
+    }
+    OutputFooter(out);
+
+    for (i = 0; i < num_paths; i++) {
+        LineReaderClose(&inputs[i].reader);
+    }
+    free(inputs);
+    free(heap);
+}
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "ledger.h"
+
+#define MIN_KEYS_PER_WORKER 65536
+
+// LSD radix sort on 11/11/10-bit digits, returns whichever of keys and tmp
+// holds the result.  Digits that are the same for every key are skipped.
+SortKey *RadixSortKeys(SortKey *keys, SortKey *tmp, int n) {
+    static const int shift[3] = { 0, 11, 22 };
+    static const uint32_t mask[3] = { 0x7ff, 0x7ff, 0x3ff };
+    int count[3][2048];
+    int pass = 0, i = 0;
+
+    if (n <= 0) return keys;
+
+    memset(count, 0, sizeof(count));
+    for (i = 0; i < n; i++) {
+        uint32_t key = keys[i].key;
+        count[0][key & 0x7ff]++;
+        count[1][(key >> 11) & 0x7ff]++;
+        count[2][key >> 22]++;
+    }
+
+    for (pass = 0; pass < 3; pass++) {
+        int *c = count[pass];
+        int sum = 0, digit = 0;
+
+        if (c[(keys[0].key >> shift[pass]) & mask[pass]] == n) continue;
+        for (digit = 0; digit <= (int)mask[pass]; digit++) {
+            int cnt = c[digit];
+            c[digit] = sum;
+            sum += cnt;
+        }
+        for (i = 0; i < n; i++) {
+            tmp[c[(keys[i].key >> shift[pass]) & mask[pass]]++] = keys[i];
+        }
+
+        SortKey *swap = keys;
+        keys = tmp;
+        tmp = swap;
+    }
+    return keys;
+}
+
+typedef struct {
+    SortKey *keys, *tmp;
+    int n;
+} SortSlice;
+
+// sort one slice and leave the result in slice->keys
+static void *SortSliceThread(void *param) {
+    SortSlice *slice = (SortSlice *)param;
+    SortKey *sorted = RadixSortKeys(slice->keys, slice->tmp, slice->n);
+
+    if (sorted != slice->keys) {
+        memcpy(slice->keys, sorted, slice->n * sizeof(SortKey));
+    }
+    return NULL;
+}
+
+typedef struct {
+    SortKey *next, *end;
+} MergeRun;
+
+static void SiftDown(MergeRun **heap, int size, int i) {
+    MergeRun *run = heap[i];
+
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= size) break;
+        if (child + 1 < size && heap[child + 1]->next->key < heap[child]->next->key) child++;
+        if (heap[child]->next->key >= run->next->key) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = run;
+}
+
+// Sort keys[0..n) using tmp[0..n) as scratch.  With more than one worker,
+// each worker radix-sorts a slice and the sorted slices are combined by a
+// heap-based k-way merge.  Returns whichever of keys and tmp holds the
+// result.  *dup is set to the first index i with sorted[i].key equal to
+// sorted[i-1].key (the smallest duplicated key), or -1 if there is none.
+SortKey *SortKeys(SortKey *keys, SortKey *tmp, int n, int num_workers, int *dup) {
+    SortSlice slices[MAX_LOAD_WORKERS];
+    pthread_t threads[MAX_LOAD_WORKERS];
+    MergeRun runs[MAX_LOAD_WORKERS], *heap[MAX_LOAD_WORKERS];
+    int i = 0;
+
+    num_workers = max(1, min(num_workers, MAX_LOAD_WORKERS));
+    num_workers = min(num_workers, n / MIN_KEYS_PER_WORKER + 1);
+    *dup = -1;
+
+    if (num_workers == 1) {
+        SortKey *sorted = RadixSortKeys(keys, tmp, n);
+        for (i = 1; i < n; i++) {
+            if (sorted[i].key == sorted[i - 1].key) {
+                *dup = i;
+                break;
+            }
+        }
+        return sorted;
+    }
+
+    for (i = 0; i < num_workers; i++) {
+        int start = (int)((int64_t)n * i / num_workers);
+        int end = (int)((int64_t)n * (i + 1) / num_workers);
+        slices[i].keys = keys + start;
+        slices[i].tmp = tmp + start;
+        slices[i].n = end - start;
+    }
+    for (i = 1; i < num_workers; i++) {
+        if (pthread_create(&threads[i], NULL, SortSliceThread, &slices[i]) != 0) {
+            fprintf(stderr, "Error: Could not create sort thread\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    SortSliceThread(&slices[0]);
+    for (i = 1; i < num_workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    int heap_size = 0;
+    for (i = 0; i < num_workers; i++) {
+        runs[i].next = slices[i].keys;
+        runs[i].end = slices[i].keys + slices[i].n;
+        if (runs[i].next < runs[i].end) heap[heap_size++] = &runs[i];
+    }
+    for (i = heap_size / 2 - 1; i >= 0; i--) {
+        SiftDown(heap, heap_size, i);
+    }
+
+    // equal keys from different slices come out back to back, so checking
+    // neighbors here covers duplicates across slice boundaries as well
+    SortKey *out = tmp;
+    for (i = 0; heap_size > 0; i++) {
+        MergeRun *run = heap[0];
+        out[i] = *run->next++;
+        if (*dup < 0 && i > 0 && out[i].key == out[i - 1].key) *dup = i;
+        if (run->next == run->end) {
+            heap[0] = heap[--heap_size];
+        }
+        if (heap_size > 0) SiftDown(heap, heap_size, 0);
+    }
+    return out;
+}
+
+static int CompareTimestamp(My402ListElem *elem1, My402ListElem *elem2) {
+    Transaction *trans1 = My402ListEntry(elem1, Transaction, link);
+    Transaction *trans2 = My402ListEntry(elem2, Transaction, link);
+    return (trans1->timestamp > trans2->timestamp) - (trans1->timestamp < trans2->timestamp);
+}
+
+static void SortedCheckDuplicates(My402List *pList) {
+    // once sorted, duplicates can only be neighbors
+    My402ListElem *elem = NULL, *next_elem = NULL;
+    for (elem = My402ListFirst(pList); elem != NULL; elem = next_elem) {
+        next_elem = My402ListNext(pList, elem);
+        if (next_elem != NULL && CompareTimestamp(elem, next_elem) == 0) {
+            Transaction *trans = My402ListEntry(elem, Transaction, link);
+            fprintf(stderr, "Error: Duplicate timestamp found: %d\n", trans->timestamp);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+void SortByTimestamp(My402List *pList, int num_workers) {
+    int n = My402ListLength(pList);
+    SortKey *keys = (SortKey *)malloc((size_t)n * sizeof(SortKey));
+    SortKey *tmp = (SortKey *)malloc((size_t)n * sizeof(SortKey));
+
+    if (n < 2 || keys == NULL || tmp == NULL) {
+        // not worth it (or no memory for it), relink the list in place
+        free(keys);
+        free(tmp);
+        My402ListSort(pList, CompareTimestamp);
+        SortedCheckDuplicates(pList);
+        return;
+    }
+
+    int i = 0;
+    My402ListElem *elem = NULL;
+    for (elem = My402ListFirst(pList); elem != NULL; elem = My402ListNext(pList, elem), i++) {
+        Transaction *trans = My402ListEntry(elem, Transaction, link);
+        keys[i].item = trans;
+        keys[i].key = (uint32_t)trans->timestamp ^ 0x80000000u;
+    }
+
+    int dup = -1;
+    SortKey *sorted = SortKeys(keys, tmp, n, num_workers, &dup);
+    if (dup >= 0) {
+        fprintf(stderr, "Error: Duplicate timestamp found: %d\n", ((Transaction *)sorted[dup].item)->timestamp);
+        exit(EXIT_FAILURE);
+    }
+
+    My402ListUnlinkAll(pList);
+    for (i = 0; i < n; i++) {
+        (void)My402ListAppendElem(pList, &((Transaction *)sorted[i].item)->link);
+    }
+    free(keys);
+    free(tmp);
+}
@@ -0,0 +1,160 @@
+/*
+ * listbench: counts heap allocations and time per million My402List
+ * appends/unlinks, once with plain malloc()'ed elements and once with a
+ * pooled list, and the cost of My402ListFind() with and without the index.
+ * Must be linked with -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+ * -Wl,--wrap=free (see the "listbench" target in the Makefile).
+ *
+ *     ./listbench [-n num_ops] [-chunk elems_per_chunk] [-find num_elems]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cs402.h"
+#include "my402list.h"
+
+extern void *__real_malloc(size_t);
+extern void *__real_calloc(size_t, size_t);
+extern void *__real_realloc(void *, size_t);
+extern void __real_free(void *);
+
+// malloc(), calloc() and realloc() calls; a realloc() that moves the block
+// frees the old one inside libc, so it counts as an allocation only
+static long num_allocs = 0;
+static long num_frees = 0;
+
+void *__wrap_malloc(size_t size) {
+    num_allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t num, size_t size) {
+    num_allocs++;
+    return __real_calloc(num, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    num_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+    if (ptr != NULL) num_frees++;
+    __real_free(ptr);
+}
+
+static double now_in_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+static void init_list(My402List *list, int chunk_size) {
+    int ok = (chunk_size > 0) ? My402ListInitPool(list, chunk_size) : My402ListInit(list);
+    if (!ok) {
+        fprintf(stderr, "Error: Could not initialize list\n");
+        exit(1);
+    }
+}
+
+// fill the list with n elements, then drain it from the front
+static void run_fill_drain(int n, int chunk_size) {
+    My402List list;
+    init_list(&list, chunk_size);
+
+    long allocs = num_allocs, frees = num_frees;
+    double start = now_in_ms();
+    for (int i = 0; i < n; i++) {
+        My402ListAppend(&list, (void *)(long)(i + 1));
+    }
+    while (!My402ListEmpty(&list)) {
+        My402ListUnlink(&list, My402ListFirst(&list));
+    }
+    My402ListUnlinkAll(&list);
+    double elapsed = now_in_ms() - start;
+
+    printf("%-10s %-12s %10d %10ld %10ld %10.3f\n", chunk_size > 0 ? "pool" : "malloc", "fill/drain",
+           n, num_allocs - allocs, num_frees - frees, elapsed);
+}
+
+// FIFO with a small standing population, the way Q1 and Q2 behave in warmup2
+static void run_fifo(int n, int chunk_size) {
+    My402List list;
+    init_list(&list, chunk_size);
+
+    long allocs = num_allocs, frees = num_frees;
+    double start = now_in_ms();
+    for (int i = 0; i < n; i++) {
+        My402ListAppend(&list, (void *)(long)(i + 1));
+        if (My402ListLength(&list) > 16) {
+            My402ListUnlink(&list, My402ListFirst(&list));
+        }
+    }
+    My402ListUnlinkAll(&list);
+    double elapsed = now_in_ms() - start;
+
+    printf("%-10s %-12s %10d %10ld %10ld %10.3f\n", chunk_size > 0 ? "pool" : "malloc", "fifo",
+           n, num_allocs - allocs, num_frees - frees, elapsed);
+}
+
+// find every element once, the way listtest's FindAllInList() does
+static void run_find(int n, int indexed) {
+    My402List list;
+    int ok = indexed ? My402ListInitIndexed(&list) : My402ListInit(&list);
+    if (!ok) {
+        fprintf(stderr, "Error: Could not initialize list\n");
+        exit(1);
+    }
+
+    long allocs = num_allocs, frees = num_frees;
+    double start = now_in_ms();
+    for (int i = 0; i < n; i++) {
+        My402ListAppend(&list, (void *)(long)(i + 1));
+    }
+    for (int i = 0; i < n; i++) {
+        if (My402ListFind(&list, (void *)(long)(i + 1)) == NULL) {
+            fprintf(stderr, "Error: %d not found\n", i + 1);
+            exit(1);
+        }
+    }
+    My402ListUnlinkAll(&list);
+    double elapsed = now_in_ms() - start;
+
+    printf("%-10s %-12s %10d %10ld %10ld %10.3f\n", indexed ? "indexed" : "malloc", "find",
+           n, num_allocs - allocs, num_frees - frees, elapsed);
+}
+
+int main(int argc, char *argv[]) {
+    int n = 1000000;
+    int chunk_size = 256;
+    int num_find = 20000;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            n = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-chunk") == 0 && i + 1 < argc) {
+            chunk_size = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-find") == 0 && i + 1 < argc) {
+            num_find = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Usage: %s [-n num_ops] [-chunk elems_per_chunk] [-find num_elems]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (n <= 0 || chunk_size <= 0 || num_find <= 0) {
+        fprintf(stderr, "Error: -n, -chunk and -find must be positive\n");
+        return 1;
+    }
+
+    printf("%-10s %-12s %10s %10s %10s %10s\n", "list", "workload", "appends", "allocs", "frees", "ms");
+    run_fill_drain(n, 0);
+    run_fill_drain(n, chunk_size);
+    run_fifo(n, 0);
+    run_fifo(n, chunk_size);
+    run_find(num_find, FALSE);
+    run_find(num_find, TRUE);
+
+    return 0;
+}
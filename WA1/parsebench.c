@@ -0,0 +1,163 @@
+/*
+ * parsebench: lines/second of the ledger line parser against the sscanf()
+ * code it replaced.  The input files are concatenated and replicated in
+ * memory up to the requested size before anything is timed.
+ *
+ *     ./parsebench [-mb size_in_mb] file ...
+ *     ./parsebench -mb 1024 w1data/f?
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "ledger.h"
+
+// what warmup1 used to do for every line
+typedef struct {
+    int timestamp;
+    double amount;
+    char description[1024];
+} OldTransaction;
+
+static double now_in_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+static char *replicate_input(int num_files, char *files[], size_t target_size, size_t *size) {
+    LedgerInput seed;
+    char *buf = NULL;
+    size_t seed_size = 0, pos = 0;
+    int i = 0;
+
+    for (i = 0; i < num_files; i++) {
+        if (!OpenLedgerInput(&seed, files[i])) {
+            fprintf(stderr, "Error: Could not open input file: %s\n", files[i]);
+            exit(1);
+        }
+        char *grown = (char *)realloc(buf, seed_size + seed.size + 1);
+        if (grown == NULL) {
+            fprintf(stderr, "Error: Could not allocate %lu bytes\n", (unsigned long)(seed_size + seed.size + 1));
+            exit(1);
+        }
+        buf = grown;
+        memcpy(buf + seed_size, seed.data, seed.size);
+        seed_size += seed.size;
+        if (seed.size > 0 && seed.data[seed.size - 1] != '\n') buf[seed_size++] = '\n';
+        CloseLedgerInput(&seed);
+    }
+    if (seed_size == 0) {
+        fprintf(stderr, "Error: empty input\n");
+        exit(1);
+    }
+
+    char *data = (char *)malloc(target_size + seed_size);
+    if (data == NULL) {
+        fprintf(stderr, "Error: Could not allocate %lu bytes\n", (unsigned long)target_size);
+        exit(1);
+    }
+    while (pos < target_size) {
+        memcpy(data + pos, buf, seed_size);
+        pos += seed_size;
+    }
+    free(buf);
+    *size = pos;
+    return data;
+}
+
+static long run_sscanf(const char *data, size_t size, double *checksum) {
+    OldTransaction trans;
+    char line[MAX_LINE_LENGTH];
+    char sign;
+    long num_lines = 0;
+    size_t pos = 0;
+
+    while (pos < size) {
+        const char *eol = (const char *)memchr(data + pos, '\n', size - pos);
+        size_t len = (eol != NULL ? (size_t)(eol - data) : size) - pos;
+
+        // as the old loader did, and line must hold it
+        if (len >= MAX_LINE_LENGTH - 1) {
+            fprintf(stderr, "Error: Line exceeds 1024 characters\n");
+            exit(1);
+        }
+        memcpy(line, data + pos, len);
+        line[len] = '\0';
+        if (sscanf(line, "%c\t%d\t%lf\t%1023[^\n]", &sign, &trans.timestamp, &trans.amount, trans.description) != 4) {
+            fprintf(stderr, "Error: malformed line\n");
+            exit(1);
+        }
+        *checksum += (sign == '-') ? -trans.amount : trans.amount;
+        num_lines++;
+        pos += len + 1;
+    }
+    return num_lines;
+}
+
+static long run_parser(const char *data, size_t size, double *checksum) {
+    TransactionView trans;
+    long num_lines = 0;
+    int64_t cents = 0;
+    size_t pos = 0;
+
+    while (pos < size) {
+        const char *eol = (const char *)memchr(data + pos, '\n', size - pos);
+        size_t len = (eol != NULL ? (size_t)(eol - data) : size) - pos;
+
+        if (len >= MAX_LINE_LENGTH - 1) {
+            fprintf(stderr, "Error: Line exceeds 1024 characters\n");
+            exit(1);
+        }
+        if (!ParseTransaction(data, pos, (int)len, &trans)) {
+            fprintf(stderr, "Error: malformed line\n");
+            exit(1);
+        }
+        cents += trans.amount;
+        num_lines++;
+        pos += len + 1;
+    }
+    *checksum = cents / 100.0;
+    return num_lines;
+}
+
+static void report(const char *name, long num_lines, size_t size, double elapsed, double checksum) {
+    printf("%-10s %12ld %10.1f %14.0f %10.1f %18.2f\n", name, num_lines, elapsed,
+           num_lines / (elapsed / 1000.0), (size / 1048576.0) / (elapsed / 1000.0), checksum);
+}
+
+int main(int argc, char *argv[]) {
+    size_t target_mb = 1024;
+    int i = 1;
+
+    if (i + 1 < argc && strcmp(argv[i], "-mb") == 0) {
+        target_mb = (size_t)atol(argv[i + 1]);
+        i += 2;
+    }
+    if (i >= argc || target_mb == 0) {
+        fprintf(stderr, "Usage: %s [-mb size_in_mb] file ...\n", argv[0]);
+        return 1;
+    }
+
+    size_t size = 0;
+    char *data = replicate_input(argc - i, argv + i, target_mb << 20, &size);
+    double checksum = 0.0, start = 0.0;
+    long num_lines = 0;
+
+    printf("%-10s %12s %10s %14s %10s %18s\n", "parser", "lines", "ms", "lines/s", "MB/s", "sum of amounts");
+
+    start = now_in_ms();
+    num_lines = run_sscanf(data, size, &checksum);
+    report("sscanf", num_lines, size, now_in_ms() - start, checksum);
+
+    checksum = 0.0;
+    start = now_in_ms();
+    num_lines = run_parser(data, size, &checksum);
+    report("ledger", num_lines, size, now_in_ms() - start, checksum);
+
+    free(data);
+    return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * sortbench: how SortKeys() scales with the number of sort workers on a
+ * synthetic array of random timestamps.
+ *
+ *     ./sortbench [-n num_keys] [-seed seed] [threads ...]
+ *     ./sortbench -n 50000000 1 2 4 8 16
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "ledger.h"
+
+static double now_in_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+// xorshift, so the keys do not depend on the libc rand()
+static uint32_t next_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return (uint32_t)(x >> 32);
+}
+
+int main(int argc, char *argv[]) {
+    int n = 50000000;
+    uint64_t seed = 402;
+    int threads[32], num_runs = 0;
+    int i = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            n = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            seed = (uint64_t)atol(argv[++i]) | 1;
+        } else if (atoi(argv[i]) > 0 && num_runs < 32) {
+            threads[num_runs++] = atoi(argv[i]);
+        } else {
+            fprintf(stderr, "Usage: %s [-n num_keys] [-seed seed] [threads ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (num_runs == 0) {
+        int defaults[] = { 1, 2, 4, 8, 16 };
+        for (num_runs = 0; num_runs < 5; num_runs++) threads[num_runs] = defaults[num_runs];
+    }
+    if (n <= 0) {
+        fprintf(stderr, "Error: -n must be positive\n");
+        return 1;
+    }
+
+    SortKey *input = (SortKey *)malloc((size_t)n * sizeof(SortKey));
+    SortKey *keys = (SortKey *)malloc((size_t)n * sizeof(SortKey));
+    SortKey *tmp = (SortKey *)malloc((size_t)n * sizeof(SortKey));
+    if (input == NULL || keys == NULL || tmp == NULL) {
+        fprintf(stderr, "Error: Could not allocate %d keys\n", n);
+        return 1;
+    }
+    for (i = 0; i < n; i++) {
+        input[i].key = next_random(&seed);
+        input[i].item = NULL;
+    }
+
+    printf("%8s %12s %10s %14s %10s\n", "threads", "keys", "ms", "keys/s", "speedup");
+    double base = 0.0;
+    for (int r = 0; r < num_runs; r++) {
+        int dup = -1;
+        memcpy(keys, input, (size_t)n * sizeof(SortKey));
+
+        double start = now_in_ms();
+        SortKey *sorted = SortKeys(keys, tmp, n, threads[r], &dup);
+        double elapsed = now_in_ms() - start;
+
+        for (i = 1; i < n; i++) {
+            if (sorted[i].key < sorted[i - 1].key) {
+                fprintf(stderr, "Error: output not sorted at %d\n", i);
+                return 1;
+            }
+        }
+        if (r == 0) base = elapsed;
+        printf("%8d %12d %10.1f %14.0f %9.2fx\n", threads[r], n, elapsed, n / (elapsed / 1000.0), base / elapsed);
+    }
+
+    free(input);
+    free(keys);
+    free(tmp);
+    return 0;
+}
@@ -9,272 +9,219 @@
 #include <stdlib.h>
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <unistd.h>
 #include "cs402.h"
 #include "my402list.h"
-
-typedef struct {
-    int timestamp;
-    double amount;
-    char description[1024];
-} Transaction;
-
-void BubbleSortForwardList(My402List *pList, int num_items);
-void BubbleForward(My402List *pList, My402ListElem **pp_elem1, My402ListElem **pp_elem2);
-char* formatDate(int timestamp);
-void formatAmount(char* buffer, double amount);
-void formatBalance(char* buffer, double balance);
-void formatDouble(char* buffer, double num);
+#include "ledger.h"
+
+void StreamLedger(const char *path);
+
+static void Usage() {
+    fprintf(stderr, "usage: warmup1 sort [-j workers] [-m memory_mb] [tfile]\n"
+                    "       warmup1 -f [tfile]\n"
+                    "       warmup1 convert [-s] [-j workers] [tfile] -o binfile\n"
+                    "       warmup1 index [-j workers] tfile\n"
+                    "       warmup1 range from to tfile\n"
+                    "       warmup1 update [-j workers] tfile\n"
+                    "       warmup1 merge tfile ...\n");
+    exit(EXIT_FAILURE);
+}
 
 int main(int argc, char *argv[]) {
     bool shouldSort = false;
-    if (argc > 1 && strcmp(argv[1], "sort") == 0) {
+    const char *mode = NULL, *path = NULL, *words[argc];
+    int num_words = 0;
+    int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    long memory_mb = 0;
+    bool follow = false, convert = false, convertSorted = false;
+    const char *out_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-j") == 0) {
+            if (i + 1 >= argc || (num_workers = atoi(argv[i + 1])) <= 0) Usage();
+            i++;
+        } else if (strcmp(argv[i], "-m") == 0) {
+            if (i + 1 >= argc || (memory_mb = atol(argv[i + 1])) <= 0) Usage();
+            i++;
+        } else if (strcmp(argv[i], "-f") == 0) {
+            follow = true;
+        } else if (strcmp(argv[i], "-o") == 0) {
+            if (i + 1 >= argc) Usage();
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "-s") == 0) {
+            convertSorted = true;
+        } else {
+            words[num_words++] = argv[i];
+        }
+    }
+    if (num_words > 0) mode = words[0];
+
+    if (mode != NULL && strcmp(mode, "range") == 0) {
+        // range from to tfile, with the window given as timestamps
+        char *end1 = NULL, *end2 = NULL;
+        if (num_words != 4) Usage();
+        long from = strtol(words[1], &end1, 10), to = strtol(words[2], &end2, 10);
+        if (*words[1] == '\0' || *end1 != '\0' || *words[2] == '\0' || *end2 != '\0') Usage();
+        from = max(from, (long)INT32_MIN);
+        to = min(to, (long)INT32_MAX);
+
+        LedgerOutput output;
+        OutputInit(&output, STDOUT_FILENO);
+        RenderLedgerRange(words[3], (int)from, (int)to, &output);
+        OutputClose(&output);
+        return 0;
+    }
+    if (mode != NULL && strcmp(mode, "merge") == 0) {
+        // each file must already be sorted
+        if (num_words < 2 || follow || memory_mb > 0 || out_path != NULL || convertSorted) Usage();
+        LedgerOutput output;
+        OutputInit(&output, STDOUT_FILENO);
+        MergeSortedLedgers(words + 1, num_words - 1, &output);
+        OutputClose(&output);
+        return 0;
+    }
+    if (num_words > 2) Usage();
+    if (num_words > 1) path = words[1];
+
+    if (mode != NULL && strcmp(mode, "update") == 0) {
+        // rows from the first one the appended lines changed
+        if (path == NULL || follow || memory_mb > 0 || out_path != NULL || convertSorted) Usage();
+        LedgerOutput output;
+        OutputInit(&output, STDOUT_FILENO);
+        UpdateLedgerIndex(path, num_workers > 0 ? num_workers : 1, &output, FALSE);
+        OutputClose(&output);
+        return 0;
+    }
+    if (mode != NULL && strcmp(mode, "index") == 0) {
+        // the same as an update from an empty index, without the report
+        if (path == NULL || follow || memory_mb > 0 || out_path != NULL || convertSorted) Usage();
+        UpdateLedgerIndex(path, num_workers > 0 ? num_workers : 1, NULL, TRUE);
+        return 0;
+    }
+    if (mode != NULL && strcmp(mode, "sort") == 0) {
         shouldSort = true;
     }
+    if (mode != NULL && strcmp(mode, "convert") == 0) {
+        convert = true;
+    }
+    if (convert != (out_path != NULL) || (convertSorted && !convert)) Usage();
+    if (num_workers <= 0) num_workers = 1;
+
+    if (follow) {
+        // no sorting here, so a lone word is the file
+        if (shouldSort || convert) Usage();
+        if (path == NULL) path = mode;
+        StreamLedger(path);
+        return 0;
+    }
+
+    if (shouldSort && memory_mb > 0) {
+        // sort within a memory budget, spilling sorted runs to disk
+        LedgerOutput output;
+        OutputInit(&output, STDOUT_FILENO);
+        ExternalSortAndRender(path, (size_t)memory_mb << 20, num_workers, &output);
+        OutputClose(&output);
+        return 0;
+    }
+
     My402List transactionList;
-    if (!My402ListInit(&transactionList)) {
+    if (!My402ListInitIntrusive(&transactionList)) {
         fprintf(stderr, "Error: Could not initialize list\n");
         return 1;
     }
 
-    FILE *inputFile;
-    if (argc > 2) {
-        inputFile = fopen(argv[2], "r");
-        if (inputFile == NULL) {
-            fprintf(stderr, "Error: Could not open input file: %s\n", argv[2]);
-            return 1;
+    LedgerInput input;
+    if (!OpenLedgerInput(&input, path)) {
+        fprintf(stderr, "Error: Could not open input file: %s\n", path != NULL ? path : "(stdin)");
+        return 1;
+    }
+    LedgerOutput output;
+    if (IsBinaryLedger(&input)) {
+        const LedgerBinHeader *header = BinaryLedgerHeader(&input);
+        if (!convert && (!shouldSort || (header->flags & LEDGER_BIN_SORTED))) {
+            // already in the order wanted, nothing to load or sort
+            OutputInit(&output, STDOUT_FILENO);
+            RenderBinaryLedger(&input, &output);
+            OutputClose(&output);
+            CloseLedgerInput(&input);
+            return 0;
         }
-    }else {
-        inputFile = stdin;
+        LoadBinaryLedger(&input, &transactionList);
+    } else {
+        LoadTransactions(&input, &transactionList, num_workers);
     }
+    // the descriptions are in input.descs now
+    ReleaseLedgerText(&input);
 
-    char line[1024];
-    char tempBuffer[1024];
-    char sign;
-    while (fgets(line, sizeof(line), inputFile)) {
-        // Check if the line exceeds 1024 characters
-        if (line[strlen(line) - 1] != '\n' && !feof(inputFile)) {
-            // Skip remaining characters of the long line
-            while (fgets(tempBuffer, sizeof(tempBuffer), inputFile) && tempBuffer[strlen(tempBuffer) - 1] != '\n');
-        
-            fprintf(stderr, "Error: Line exceeds 1024 characters\n");
-            fclose(inputFile);
-            return 1;
-        }
-        Transaction *trans = (Transaction *)malloc(sizeof(Transaction));
-        if (sscanf(line, "%c\t%d\t%lf\t%[^\n]", &sign, &trans->timestamp, &trans->amount, trans->description) == 4) {
-            if (sign == '-') {
-                trans->amount = -trans->amount;
-            } else if(sign == '+'){
-                trans->amount = trans->amount;
-            }else{
-                fprintf(stderr, "Error: malformed line\n");
-                exit(EXIT_FAILURE);
-            }
-            My402ListAppend(&transactionList, trans);
-        }else{
-            fprintf(stderr, "Error: malformed line\n");
-            exit(EXIT_FAILURE);
-        }
+    if (shouldSort || convertSorted) {
+        SortByTimestamp(&transactionList, num_workers);
     }
-    fclose(inputFile);
 
-    if (shouldSort) {
-        int num_items = My402ListLength(&transactionList);
-        BubbleSortForwardList(&transactionList, num_items);  // Sort by timestamp
+    if (convert) {
+        WriteBinaryLedger(&transactionList, &input.descs, out_path);
+        My402ListUnlinkAll(&transactionList);
+        CloseLedgerInput(&input);
+        return 0;
     }
 
-    printf("+-----------------+--------------------------+----------------+----------------+\n");
-    printf("|       Date      | Description              |         Amount |        Balance |\n");
-    printf("+-----------------+--------------------------+----------------+----------------+\n");
+    OutputInit(&output, STDOUT_FILENO);
+    OutputHeader(&output);
 
-    double balance = 0.0;
+    int64_t balance = 0;
     My402ListElem *elem = NULL;
     for (elem = My402ListFirst(&transactionList); elem != NULL; elem = My402ListNext(&transactionList, elem)) {
-        Transaction *trans = (Transaction *)elem->obj;
-        balance += trans->amount;
-
-        char amount[16], balance_str[16], description[25];
-        strncpy(description, trans->description, 24);
-        description[24] = '\0';
-        
-        int len = strlen(description);
-        for (int i = len; i < 24; i++) {
-            description[i] = ' ';
-        }
-        description[24] = '\0';
-
-        formatAmount(amount, trans->amount);
-        formatBalance(balance_str, balance);
-
-        printf("| %-15s | %-24s | %14s | %14s |\n", formatDate(trans->timestamp), description, amount, balance_str);
+        Transaction *trans = My402ListEntry(elem, Transaction, link);
+        balance = AddMoney(balance, trans->amount);
+        OutputTransaction(&output, trans, &input.descs, balance);
     }
 
-    printf("+-----------------+--------------------------+----------------+----------------+\n");
+    OutputFooter(&output);
+    OutputClose(&output);
 
     My402ListUnlinkAll(&transactionList);
+    CloseLedgerInput(&input);
 
     return 0;
 }
 
-void BubbleSortForwardList(My402List *pList, int num_items) {
-    My402ListElem *elem = NULL;
-    int i = 0;
-
-    if (My402ListLength(pList) != num_items) {
-        fprintf(stderr, "List length is not %1d in BubbleSortForwardList().\n", num_items);
-        exit(1);
-    }
-
-    for (i = 0; i < num_items; i++) {
-        int j = 0, something_swapped = FALSE;
-        My402ListElem *next_elem = NULL;
-
-        for (elem = My402ListFirst(pList), j = 0; j < num_items - i - 1; elem = next_elem, j++) {
-            Transaction *cur_trans = (Transaction *)(elem->obj);
-            Transaction *next_trans = NULL;
-
-            next_elem = My402ListNext(pList, elem);
-            if (next_elem != NULL) {
-                next_trans = (Transaction *)(next_elem->obj);
-
-                if (cur_trans->timestamp > next_trans->timestamp) {
-                    BubbleForward(pList, &elem, &next_elem);
-                    something_swapped = TRUE;
-                }else if(cur_trans->timestamp == next_trans->timestamp) {
-                    fprintf(stderr, "Error: Duplicate timestamp found: %d\n", cur_trans->timestamp);
-                    exit(EXIT_FAILURE);
-                }
-            }
-        }
-        if (!something_swapped) break;
-    }
-}
-
-void BubbleForward(My402List *pList, My402ListElem **pp_elem1, My402ListElem **pp_elem2) {
-    My402ListElem *elem1 = (*pp_elem1), *elem2 = (*pp_elem2);
-    void *obj1 = elem1->obj, *obj2 = elem2->obj;
-    My402ListElem *elem1prev = My402ListPrev(pList, elem1);
-    My402ListElem *elem2next = My402ListNext(pList, elem2);
-
-    My402ListUnlink(pList, elem1);
-    My402ListUnlink(pList, elem2);
-    if (elem1prev == NULL) {
-        (void)My402ListPrepend(pList, obj2);
-        *pp_elem1 = My402ListFirst(pList);
-    } else {
-        (void)My402ListInsertAfter(pList, obj2, elem1prev);
-        *pp_elem1 = My402ListNext(pList, elem1prev);
+// Unsorted output is in input order, so each row can go out as soon as its
+// line is read.  Only the LineReader and output buffers are ever held, and
+// whatever has been rendered is flushed before waiting for more input.
+void StreamLedger(const char *path) {
+    LineReader reader;
+    LedgerOutput output;
+    TransactionView trans;
+    const char *line = NULL;
+    int len = 0;
+    int64_t balance = 0;
+
+    if (!LineReaderOpen(&reader, path, STDIN_CHUNK_SIZE)) {
+        fprintf(stderr, "Error: Could not open input file: %s\n", path != NULL ? path : "(stdin)");
+        exit(EXIT_FAILURE);
     }
-    if (elem2next == NULL) {
-        (void)My402ListAppend(pList, obj1);
-        *pp_elem2 = My402ListLast(pList);
-    } else {
-        (void)My402ListInsertBefore(pList, obj1, elem2next);
-        *pp_elem2 = My402ListPrev(pList, elem2next);
-    }
-}
-
-char* formatDate(int timestamp) {
-    static char formattedDate[32]; // buffer to store the formatted date
-    char *ctimeStr;
-    
-    time_t rawtime = (time_t)timestamp;
-    ctimeStr = ctime(&rawtime); // get ctime string
-
-    // Remove the newline character at the end of ctime output
-    ctimeStr[strlen(ctimeStr) - 1] = '\0';
-
-    // Format the string to remove extra space before day if it's a single digit
-    sprintf(formattedDate, "%.3s %.3s %.2s %.4s", ctimeStr, ctimeStr + 4, ctimeStr + 8, ctimeStr + 20);
-
-    return formattedDate;
-}
-
-void formatAmount(char* buffer, double amount) {
-    if (amount >= 10000000 || amount <= -10000000) {
-        if (amount < 0) {
-            snprintf(buffer, 16, "(\\?,\\?\\?,\\?\\?.\\?\\?)");
-        } else {
-            snprintf(buffer, 16, " ?,???,???.?? ");
-        }
-    } else {
-        if (amount < 0) {
-            formatDouble(buffer,-amount);
-            char temp[32]; 
-            strcpy(temp, buffer);
-            int blankLength = 14 - strlen(temp) - 2;
-            snprintf(buffer, 16, "(%*s%s)",blankLength," ", temp);
-        } else {
-            formatDouble(buffer,amount);
-            char temp[32]; 
-            strcpy(temp, buffer);
-            snprintf(buffer, 16, " %s ", temp);
-        }
+    if (LineReaderIsBinaryLedger(&reader)) {
+        fprintf(stderr, "Error: binary ledger not supported with -f, sort it instead\n");
+        exit(EXIT_FAILURE);
     }
-}
-
-void formatBalance(char* buffer, double balance) {
-    if (balance >= 10000000 || balance <= -10000000) {
-        snprintf(buffer, 16, "?,???,???.??");
-    } else {
-        if (balance < 0) {
-            formatDouble(buffer,-balance);
-            char temp[32]; 
-            strcpy(temp, buffer);
-            int blankLength = 14 - strlen(temp) - 2;
-            snprintf(buffer, 16, "(%*s%s)",blankLength," ", temp);
-        } else {
-            formatDouble(buffer,balance);
-            char temp[32]; 
-            strcpy(temp, buffer);
-            snprintf(buffer, 16, " %s ", temp);
+    OutputInit(&output, STDOUT_FILENO);
+    // flushes are small and frequent here, vmsplice() would need a new
+    // buffer for each one
+    output.use_vmsplice = false;
+
+    OutputHeader(&output);
+    for (;;) {
+        if (!LineReaderPending(&reader)) OutputFlush(&output);
+        if (!LineReaderNext(&reader, &line, &len)) break;
+        if (!ParseTransaction(line, 0, len, &trans)) {
+            OutputFlush(&output);
+            fprintf(stderr, "Error: malformed line\n");
+            exit(EXIT_FAILURE);
         }
+        balance = AddMoney(balance, trans.amount);
+        OutputRow(&output, &trans, line, balance);
     }
+    OutputFooter(&output);
+    OutputClose(&output);
+    LineReaderClose(&reader);
 }
-
-// Helper function to reverse a string
-void reverse(char* str) {
-    int len = strlen(str);
-    for (int i = 0; i < len / 2; i++) {
-        char temp = str[i];
-        str[i] = str[len - i - 1];
-        str[len - i - 1] = temp;
-    }
-}
-
-void formatDouble(char* buffer, double num) {
-    int int_part = (int)num;  // Integer part
-    int decimal_part = (int)round((num - int_part) * 100);  // Two decimal places, rounded
-    
-    if (decimal_part == 100){
-        int_part += 1;
-        decimal_part = 0;
-    }
-
-    char temp[32];
-    int index = 0;
-    int count = 0;
-
-    // Handle the integer part and add commas
-    if (int_part == 0) {
-        temp[index++] = '0';  // If the integer part is 0, ensure we print '0'
-    } else {
-        while (int_part > 0) {
-            if (count > 0 && count % 3 == 0) {
-                temp[index++] = ',';
-            }
-            temp[index++] = '0' + (int_part % 10);
-            int_part /= 10;
-            count++;
-        }
-    }
-    
-    temp[index] = '\0';
-    reverse(temp);  // Reverse the string to get the correct order
-    strcpy(buffer, temp);  // Write the integer part to the buffer
-
-    // Format the decimal part with exactly two digits
-    char decimal_str[10];
-    snprintf(decimal_str, sizeof(decimal_str), ".%02d", decimal_part);  // Ensure two decimal places
-    strcat(buffer, decimal_str);  // Concatenate decimal part to the buffer
-}
\ No newline at end of file
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "dispatch.h"
+
+int DispatchInit(Dispatcher *d, int num_servers, int steal) {
+    if (num_servers <= 0) return FALSE;
+    d->deques = (DispatchDeque *)malloc((size_t)num_servers * sizeof(DispatchDeque));
+    if (d->deques == NULL) return FALSE;
+    d->num_deques = num_servers;
+    for (int i = 0; i < num_servers; i++) {
+        pthread_mutex_init(&d->deques[i].lock, NULL);
+        My402ListInitIntrusive(&d->deques[i].queue);
+        pthread_cond_init(&d->deques[i].ready, NULL);
+        d->deques[i].waiting = 0;
+    }
+    d->steal = steal;
+    d->num_pushed = 0;
+    pthread_mutex_init(&d->take_lock, NULL);
+    d->num_taken = 0;
+    d->on_take = NULL;
+    d->num_queued = 0;
+    d->num_idle = 0;
+    pthread_mutex_init(&d->idle_lock, NULL);
+    pthread_cond_init(&d->idle_cond, NULL);
+    d->closed = FALSE;
+    return TRUE;
+}
+
+// The elements still queued belong to the caller, they are only unlinked.
+void DispatchDestroy(Dispatcher *d) {
+    for (int i = 0; i < d->num_deques; i++) {
+        My402ListUnlinkAll(&d->deques[i].queue);
+        pthread_mutex_destroy(&d->deques[i].lock);
+        pthread_cond_destroy(&d->deques[i].ready);
+    }
+    free(d->deques);
+    d->deques = NULL;
+    d->num_deques = 0;
+    pthread_mutex_destroy(&d->take_lock);
+    pthread_mutex_destroy(&d->idle_lock);
+    pthread_cond_destroy(&d->idle_cond);
+}
+
+static void WakeOne(Dispatcher *d) {
+    pthread_mutex_lock(&d->idle_lock);
+    pthread_cond_signal(&d->idle_cond);
+    pthread_mutex_unlock(&d->idle_lock);
+}
+
+static int Closed(Dispatcher *d) {
+    return __atomic_load_n(&d->closed, __ATOMIC_SEQ_CST);
+}
+
+// Deques are filled round-robin.  Meant for a single producer.
+void DispatchPush(Dispatcher *d, My402ListElem *elem) {
+    unsigned long k = d->num_pushed;
+    DispatchDeque *deque = &d->deques[k % d->num_deques];
+
+    pthread_mutex_lock(&deque->lock);
+    My402ListAppendElem(&deque->queue, elem);
+    __atomic_store_n(&d->num_pushed, k + 1, __ATOMIC_SEQ_CST);
+    // only the server holding take_lock can be waiting
+    if (deque->waiting > 0) pthread_cond_signal(&deque->ready);
+    pthread_mutex_unlock(&deque->lock);
+
+    // Only the first element wakes a stealing server, DispatchTake()
+    // passes the wakeup on while there is more.  A sleeper counts itself
+    // idle before it looks at num_queued, and this counts the element
+    // before looking at num_idle, so one of the two always sees the other.
+    if (__atomic_add_fetch(&d->num_queued, 1, __ATOMIC_SEQ_CST) == 1 && d->steal &&
+            __atomic_load_n(&d->num_idle, __ATOMIC_SEQ_CST) > 0) {
+        WakeOne(d);
+    }
+}
+
+static void UnlockDeque(void *arg) {
+    DispatchDeque *deque = (DispatchDeque *)arg;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+static void UnlockTake(void *arg) {
+    Dispatcher *d = (Dispatcher *)arg;
+    pthread_mutex_unlock(&d->take_lock);
+}
+
+// Take the oldest element and hand it to on_take before the next server
+// gets its turn.  If it has not been pushed yet, return NULL, or with wait
+// sleep until it is, or until the dispatcher is closed.
+static My402ListElem *TakeOldest(Dispatcher *d, int server, int wait, void (*on_take)(My402ListElem*, int)) {
+    My402ListElem *elem = NULL;
+
+    pthread_mutex_lock(&d->take_lock);
+    // pthread_cond_wait() is a cancellation point and returns with the
+    // locks held
+    pthread_cleanup_push(UnlockTake, d);
+    unsigned long t = d->num_taken;
+    DispatchDeque *deque = &d->deques[t % d->num_deques];
+
+    pthread_mutex_lock(&deque->lock);
+    pthread_cleanup_push(UnlockDeque, deque);
+    // element t is the front of its deque once it has been pushed
+    while (wait && My402ListEmpty(&deque->queue) &&
+            !(Closed(d) && t >= __atomic_load_n(&d->num_pushed, __ATOMIC_SEQ_CST))) {
+        deque->waiting++;
+        pthread_cond_wait(&deque->ready, &deque->lock);
+        deque->waiting--;
+    }
+    elem = My402ListFirst(&deque->queue);
+    if (elem != NULL) My402ListUnlink(&deque->queue, elem);
+    pthread_cleanup_pop(1);
+
+    if (elem != NULL) {
+        __atomic_store_n(&d->num_taken, t + 1, __ATOMIC_SEQ_CST);
+        __atomic_sub_fetch(&d->num_queued, 1, __ATOMIC_SEQ_CST);
+        if (on_take != NULL) on_take(elem, server);
+    }
+    pthread_cleanup_pop(1);
+    return elem;
+}
+
+// A peek without the lock, so that empty deques cost no locking.
+static int DequeEmpty(DispatchDeque *deque) {
+    return __atomic_load_n(&deque->queue.num_members, __ATOMIC_RELAXED) == 0;
+}
+
+static My402ListElem *TakeFirst(DispatchDeque *deque) {
+    My402ListElem *elem = NULL;
+
+    if (DequeEmpty(deque)) return NULL;
+    pthread_mutex_lock(&deque->lock);
+    elem = My402ListFirst(&deque->queue);
+    if (elem != NULL) My402ListUnlink(&deque->queue, elem);
+    pthread_mutex_unlock(&deque->lock);
+    return elem;
+}
+
+// Move the back half of victim (rounded up) to the back of own, keeping
+// its order, and return the first of them.  Taking half rather than one
+// means a server that keeps running dry steals O(log n) times, not n.
+static My402ListElem *StealHalf(DispatchDeque *victim, DispatchDeque *own) {
+    My402List batch;
+    My402ListElem *elem = NULL;
+
+    if (DequeEmpty(victim)) return NULL;
+    My402ListInitIntrusive(&batch);
+    pthread_mutex_lock(&victim->lock);
+    for (int k = (My402ListLength(&victim->queue) + 1) / 2; k > 0; k--) {
+        elem = My402ListLast(&victim->queue);
+        My402ListUnlink(&victim->queue, elem);
+        My402ListPrependElem(&batch, elem);
+    }
+    pthread_mutex_unlock(&victim->lock);
+    if (My402ListEmpty(&batch)) return NULL;
+
+    elem = My402ListFirst(&batch);
+    My402ListUnlink(&batch, elem);
+    if (!My402ListEmpty(&batch)) {
+        pthread_mutex_lock(&own->lock);
+        while (!My402ListEmpty(&batch)) {
+            My402ListElem *first = My402ListFirst(&batch);
+            My402ListUnlink(&batch, first);
+            My402ListAppendElem(&own->queue, first);
+        }
+        pthread_mutex_unlock(&own->lock);
+    }
+    return elem;
+}
+
+// The next element for server (0 .. num_servers - 1), or NULL if there is
+// nothing queued right now.  Without steal this is the oldest element,
+// whichever server asks.  on_take is not called.
+My402ListElem *DispatchPoll(Dispatcher *d, int server) {
+    DispatchDeque *own = &d->deques[server];
+    My402ListElem *elem = NULL;
+
+    if (!d->steal) {
+        // a server can sit on take_lock waiting for a push, but only while
+        // everything pushed has been taken
+        if (__atomic_load_n(&d->num_taken, __ATOMIC_SEQ_CST) >= __atomic_load_n(&d->num_pushed, __ATOMIC_SEQ_CST)) {
+            return NULL;
+        }
+        return TakeOldest(d, server, FALSE, NULL);
+    }
+
+    if (__atomic_load_n(&d->num_queued, __ATOMIC_SEQ_CST) == 0) return NULL;
+    elem = TakeFirst(own);
+    for (int k = 1; elem == NULL && k < d->num_deques; k++) {
+        elem = StealHalf(&d->deques[(server + k) % d->num_deques], own);
+    }
+    if (elem != NULL) __atomic_sub_fetch(&d->num_queued, 1, __ATOMIC_SEQ_CST);
+    return elem;
+}
+
+static void UnlockIdle(void *arg) {
+    Dispatcher *d = (Dispatcher *)arg;
+    pthread_mutex_unlock(&d->idle_lock);
+}
+
+// Like DispatchPoll(), but sleeps until there is something to take, and
+// calls on_take.  Returns NULL once the dispatcher is closed and empty.
+My402ListElem *DispatchTake(Dispatcher *d, int server) {
+    if (!d->steal) return TakeOldest(d, server, TRUE, d->on_take);
+
+    for (;;) {
+        My402ListElem *elem = DispatchPoll(d, server);
+        if (elem != NULL) {
+            if (__atomic_load_n(&d->num_queued, __ATOMIC_SEQ_CST) > 0 &&
+                    __atomic_load_n(&d->num_idle, __ATOMIC_SEQ_CST) > 0) {
+                WakeOne(d);
+            }
+            if (d->on_take != NULL) d->on_take(elem, server);
+            return elem;
+        }
+
+        int closed = FALSE;
+        pthread_mutex_lock(&d->idle_lock);
+        pthread_cleanup_push(UnlockIdle, d);
+        __atomic_add_fetch(&d->num_idle, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&d->num_queued, __ATOMIC_SEQ_CST) == 0 && !Closed(d)) {
+            pthread_cond_wait(&d->idle_cond, &d->idle_lock);
+        }
+        __atomic_sub_fetch(&d->num_idle, 1, __ATOMIC_SEQ_CST);
+        closed = Closed(d);
+        pthread_cleanup_pop(1);
+
+        if (closed && __atomic_load_n(&d->num_queued, __ATOMIC_SEQ_CST) == 0) return NULL;
+    }
+}
+
+// Wake every server; they return NULL from DispatchTake() once the deques
+// are empty.  A waiter checks closed under its lock, so taking each lock
+// here before waking it means none of them misses this.
+void DispatchClose(Dispatcher *d) {
+    __atomic_store_n(&d->closed, TRUE, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < d->num_deques; i++) {
+        pthread_mutex_lock(&d->deques[i].lock);
+        pthread_cond_broadcast(&d->deques[i].ready);
+        pthread_mutex_unlock(&d->deques[i].lock);
+    }
+    pthread_mutex_lock(&d->idle_lock);
+    pthread_cond_broadcast(&d->idle_cond);
+    pthread_mutex_unlock(&d->idle_lock);
+}
+
+int DispatchLength(Dispatcher *d) {
+    return __atomic_load_n(&d->num_queued, __ATOMIC_SEQ_CST);
+}
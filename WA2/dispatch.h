@@ -0,0 +1,63 @@
+#ifndef _DISPATCH_H_
+#define _DISPATCH_H_
+
+#include <pthread.h>
+#include "cs402.h"
+#include "my402list.h"
+
+/* one server's share of the queue, an intrusive list under its own lock */
+typedef struct tagDispatchDeque {
+    pthread_mutex_t lock;
+    My402List queue;
+
+    pthread_cond_t ready;  /* FIFO: the server whose turn it is waits here */
+    int waiting;           /* FIFO: servers asleep on ready */
+} DispatchDeque;
+
+/*
+ * A queue shared by num_servers servers.  Element k (counting from 0) goes
+ * to deque k % num_servers, so the producer and a server only meet on a
+ * lock every num_servers-th element.
+ *
+ * By default elements are taken in the order they were pushed: servers
+ * take turns under take_lock, and the one holding it takes element
+ * num_taken from the front of deque num_taken % num_servers, then runs
+ * on_take.  So on_take sees the elements in order, as it would under a
+ * single queue's lock.
+ *
+ * With steal, a server takes from the front of its own deque and, when
+ * that is empty, steals the back half of another's, so servers only meet
+ * on a lock when one of them runs dry.  Elements can then be taken out of
+ * order.  Servers with nothing to do sleep on idle_cond.
+ */
+typedef struct tagDispatcher {
+    int num_deques;
+    DispatchDeque *deques;
+    int steal;                  /* work stealing instead of FIFO */
+
+    unsigned long num_pushed;   /* written by the producer only, atomic */
+    pthread_mutex_t take_lock;  /* FIFO: a server's turn to take */
+    unsigned long num_taken;    /* FIFO: under take_lock, atomic to read */
+
+    /* if set, DispatchTake() calls it with the element and the server
+       before the next element can be taken (in FIFO mode) */
+    void (*on_take)(My402ListElem*, int);
+
+    int num_queued;       /* elements in all deques, atomic */
+    int num_idle;         /* steal: servers asleep in DispatchTake(), atomic */
+
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    int closed;           /* nothing more will be pushed, atomic */
+} Dispatcher;
+
+extern int  DispatchInit(Dispatcher*, int, int);
+extern void DispatchDestroy(Dispatcher*);
+
+extern void DispatchPush(Dispatcher*, My402ListElem*);
+extern My402ListElem *DispatchTake(Dispatcher*, int);
+extern My402ListElem *DispatchPoll(Dispatcher*, int);
+extern void DispatchClose(Dispatcher*);
+extern int  DispatchLength(Dispatcher*);
+
+#endif /*_DISPATCH_H_*/
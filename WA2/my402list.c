@@ -10,65 +10,220 @@ int My402ListInit(My402List *list) {
     list->num_members = 0;
     list->anchor.next = &(list->anchor);
     list->anchor.prev = &(list->anchor);
+    list->chunk_size = 0;
+    list->chunks = NULL;
+    list->free_elems = NULL;
+    list->intrusive = FALSE;
+    list->indexed = FALSE;
+    list->index = NULL;
     return TRUE;
 }
 
-int My402ListLength(My402List *list) {
-    return list->num_members;
+// Same as My402ListInit(), but elements are carved out of chunks of
+// chunk_size elements and recycled through a free list instead of going
+// through malloc()/free() on every insert and unlink.
+int My402ListInitPool(My402List *list, int chunk_size) {
+    if (!My402ListInit(list)) return FALSE;
+    if (chunk_size <= 0) return FALSE;
+    list->chunk_size = chunk_size;
+    return TRUE;
 }
 
-int My402ListEmpty(My402List *list) {
-    return list->num_members == 0;
+// Same as My402ListInit(), but the list never allocates or frees elements.
+// They are embedded in the caller's objects and linked in with the *Elem
+// functions below; My402ListUnlink() and My402ListUnlinkAll() only unlink.
+int My402ListInitIntrusive(My402List *list) {
+    if (!My402ListInit(list)) return FALSE;
+    list->intrusive = TRUE;
+    return TRUE;
 }
 
-int My402ListAppend(My402List *list, void *obj) {
-    My402ListElem *new_elem = (My402ListElem *)malloc(sizeof(My402ListElem));
-    if (new_elem == NULL) return FALSE;
+#define INDEX_INITIAL_SLOTS 16
 
-    new_elem->obj = obj;
-    new_elem->next = &(list->anchor);
-    new_elem->prev = list->anchor.prev;
+static size_t IndexSize(int num_slots) {
+    return sizeof(My402ListIndex) + (size_t)num_slots * sizeof(My402ListElem *);
+}
 
-    list->anchor.prev->next = new_elem;
-    list->anchor.prev = new_elem;
-    list->num_members++;
+static My402ListIndex *NewIndex(int num_slots) {
+    My402ListIndex *index = (My402ListIndex *)calloc(1, IndexSize(num_slots));
+    if (index != NULL) index->num_slots = num_slots;
+    return index;
+}
 
+// Same as My402ListInit(), but My402ListFind() is O(1): every element is
+// also kept in a hash table keyed on its obj.  Lists created any other way
+// do not have the table and do not pay for it.
+int My402ListInitIndexed(My402List *list) {
+    if (!My402ListInit(list)) return FALSE;
+    list->indexed = TRUE;
     return TRUE;
 }
 
-int My402ListPrepend(My402List *list, void *obj) {
-    My402ListElem *new_elem = (My402ListElem *)malloc(sizeof(My402ListElem));
-    if (new_elem == NULL) return FALSE;
+// Fibonacci hashing, the low bits of a pointer are mostly alignment.
+static int IndexHome(My402ListIndex *index, void *obj) {
+    unsigned long long hash = (unsigned long long)(size_t)obj * 0x9e3779b97f4a7c15ull;
+    return (int)(hash >> 32) & (index->num_slots - 1);
+}
 
-    new_elem->obj = obj;
-    new_elem->next = list->anchor.next;
-    new_elem->prev = &(list->anchor);
+static void IndexPut(My402ListIndex *index, My402ListElem *elem) {
+    int mask = index->num_slots - 1, i = IndexHome(index, elem->obj);
+
+    while (index->slots[i] != NULL) i = (i + 1) & mask;
+    index->slots[i] = elem;
+}
+
+// Called before elem is linked, so on failure the list is left as it was.
+static int IndexAdd(My402List *list, My402ListElem *elem) {
+    My402ListIndex *index = list->index;
+
+    if (index == NULL) {
+        // the first element since the list was created or emptied
+        index = NewIndex(INDEX_INITIAL_SLOTS);
+        if (index == NULL) return FALSE;
+        list->index = index;
+    }
+    if (2 * (list->num_members + 1) > index->num_slots) {
+        My402ListIndex *bigger = NewIndex(2 * index->num_slots);
+        if (bigger == NULL) return FALSE;
+        for (int i = 0; i < index->num_slots; i++) {
+            if (index->slots[i] != NULL) IndexPut(bigger, index->slots[i]);
+        }
+        free(index);
+        list->index = index = bigger;
+    }
+    IndexPut(index, elem);
+    return TRUE;
+}
 
-    list->anchor.next->prev = new_elem;
-    list->anchor.next = new_elem;
+// Linear probing with backward-shift deletion, so there are no tombstones:
+// later entries of the cluster move up into the hole unless that would put
+// them before their home slot.
+static void IndexRemove(My402List *list, My402ListElem *elem) {
+    My402ListIndex *index = list->index;
+    int mask = index->num_slots - 1, i = IndexHome(index, elem->obj);
+
+    while (index->slots[i] != elem) i = (i + 1) & mask;
+    for (int j = (i + 1) & mask; index->slots[j] != NULL; j = (j + 1) & mask) {
+        int home = IndexHome(index, index->slots[j]->obj);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            index->slots[i] = index->slots[j];
+            i = j;
+        }
+    }
+    index->slots[i] = NULL;
+}
+
+static My402ListElem *NewElem(My402List *list) {
+    if (list->intrusive) return NULL;
+    if (list->chunk_size == 0) {
+        return (My402ListElem *)malloc(sizeof(My402ListElem));
+    }
+    if (list->free_elems == NULL) {
+        My402ListChunk *chunk = (My402ListChunk *)malloc(sizeof(My402ListChunk) + list->chunk_size * sizeof(My402ListElem));
+        if (chunk == NULL) return NULL;
+
+        My402ListElem *elems = (My402ListElem *)(chunk + 1);
+        for (int i = 0; i < list->chunk_size - 1; i++) {
+            elems[i].next = &elems[i + 1];
+        }
+        elems[list->chunk_size - 1].next = NULL;
+
+        chunk->next = list->chunks;
+        list->chunks = chunk;
+        list->free_elems = elems;
+    }
+    My402ListElem *elem = list->free_elems;
+    list->free_elems = elem->next;
+    return elem;
+}
+
+static void FreeElem(My402List *list, My402ListElem *elem) {
+    if (list->intrusive) return;
+    if (list->chunk_size == 0) {
+        free(elem);
+        return;
+    }
+    elem->next = list->free_elems;
+    list->free_elems = elem;
+}
+
+// Link new_elem in after prev.  Only fails if the index cannot grow.
+static int LinkElem(My402List *list, My402ListElem *new_elem, My402ListElem *prev) {
+    if (list->indexed && !IndexAdd(list, new_elem)) return FALSE;
+
+    new_elem->next = prev->next;
+    new_elem->prev = prev;
+
+    prev->next->prev = new_elem;
+    prev->next = new_elem;
     list->num_members++;
+    return TRUE;
+}
 
+// A new element holding obj, linked in after prev.
+static int LinkObj(My402List *list, void *obj, My402ListElem *prev) {
+    My402ListElem *new_elem = NewElem(list);
+    if (new_elem == NULL) return FALSE;
+
+    new_elem->obj = obj;
+    if (!LinkElem(list, new_elem, prev)) {
+        FreeElem(list, new_elem);
+        return FALSE;
+    }
     return TRUE;
 }
 
+int My402ListLength(My402List *list) {
+    return list->num_members;
+}
+
+int My402ListEmpty(My402List *list) {
+    return list->num_members == 0;
+}
+
+int My402ListAppend(My402List *list, void *obj) {
+    return LinkObj(list, obj, list->anchor.prev);
+}
+
+int My402ListPrepend(My402List *list, void *obj) {
+    return LinkObj(list, obj, &(list->anchor));
+}
+
 void My402ListUnlink(My402List *list, My402ListElem *elem) {
     if (elem == NULL) return;
 
+    if (list->index != NULL) IndexRemove(list, elem);
     elem->prev->next = elem->next;
     elem->next->prev = elem->prev;
 
-    free(elem);
+    FreeElem(list, elem);
     list->num_members--;
 }
 
 void My402ListUnlinkAll(My402List *list) {
-    My402ListElem *elem = list->anchor.next;
-    while (elem != &(list->anchor)) {
-        My402ListElem *next_elem = elem->next;
-        free(elem);
-        elem = next_elem;
+    if (list->intrusive) {
+        // nothing to free, the elements belong to the caller
+    } else if (list->chunk_size != 0) {
+        // every element lives in a chunk, so hand the chunks back wholesale
+        while (list->chunks != NULL) {
+            My402ListChunk *next_chunk = list->chunks->next;
+            free(list->chunks);
+            list->chunks = next_chunk;
+        }
+        list->free_elems = NULL;
+    } else {
+        My402ListElem *elem = list->anchor.next;
+        while (elem != &(list->anchor)) {
+            My402ListElem *next_elem = elem->next;
+            free(elem);
+            elem = next_elem;
+        }
     }
 
+    // like the chunks, the table goes too; IndexAdd() makes a new one
+    free(list->index);
+    list->index = NULL;
+
     list->anchor.next = &(list->anchor);
     list->anchor.prev = &(list->anchor);
     list->num_members = 0;
@@ -78,38 +233,100 @@ int My402ListInsertBefore(My402List *list, void *obj, My402ListElem *elem) {
     if (elem == NULL) {
         return My402ListPrepend(list, obj);
     }
-
-    My402ListElem *new_elem = (My402ListElem *)malloc(sizeof(My402ListElem));
-    if (new_elem == NULL) return FALSE;
-
-    new_elem->obj = obj;
-    new_elem->next = elem;
-    new_elem->prev = elem->prev;
-
-    elem->prev->next = new_elem;
-    elem->prev = new_elem;
-
-    list->num_members++;
-    return TRUE;
+    return LinkObj(list, obj, elem->prev);
 }
 
 int My402ListInsertAfter(My402List *list, void *obj, My402ListElem *elem) {
     if (elem == NULL) {
         return My402ListAppend(list, obj);
     }
+    return LinkObj(list, obj, elem);
+}
+
+// Stable bottom-up merge sort.  Relinks the existing elements, so it never
+// allocates and works on pooled and intrusive lists alike.  cmp() returns
+// <0, 0 or >0 like strcmp(); equal elements keep their original order.
+void My402ListSort(My402List *list, int (*cmp)(My402ListElem*, My402ListElem*)) {
+    if (list->num_members < 2) return;
 
-    My402ListElem *new_elem = (My402ListElem *)malloc(sizeof(My402ListElem));
+    // sort as a NULL-terminated singly-linked list, fix up prev at the end
+    My402ListElem *head = list->anchor.next;
+    list->anchor.prev->next = NULL;
+
+    for (int run_size = 1; ; run_size *= 2) {
+        My402ListElem *p = head, *tail = NULL;
+        int num_merges = 0;
+
+        head = NULL;
+        while (p != NULL) {
+            My402ListElem *q = p;
+            int p_size = 0, q_size = run_size;
+
+            num_merges++;
+            while (p_size < run_size && q != NULL) {
+                p_size++;
+                q = q->next;
+            }
+            while (p_size > 0 || (q_size > 0 && q != NULL)) {
+                My402ListElem *e;
+                if (p_size == 0) {
+                    e = q; q = q->next; q_size--;
+                } else if (q_size == 0 || q == NULL || cmp(p, q) <= 0) {
+                    e = p; p = p->next; p_size--;
+                } else {
+                    e = q; q = q->next; q_size--;
+                }
+                if (tail == NULL) {
+                    head = e;
+                } else {
+                    tail->next = e;
+                }
+                tail = e;
+            }
+            p = q;
+        }
+        tail->next = NULL;
+        if (num_merges <= 1) break;
+    }
+
+    My402ListElem *prev = &(list->anchor);
+    for (My402ListElem *elem = head; elem != NULL; elem = elem->next) {
+        elem->prev = prev;
+        prev->next = elem;
+        prev = elem;
+    }
+    prev->next = &(list->anchor);
+    list->anchor.prev = prev;
+}
+
+// The *Elem functions link a caller-owned element (normally embedded in the
+// caller's object, see My402ListEntry()) and leave elem->obj alone.  They are
+// meant for lists created with My402ListInitIntrusive(); on an indexed list
+// elem->obj must be set before the element is linked.
+int My402ListAppendElem(My402List *list, My402ListElem *new_elem) {
     if (new_elem == NULL) return FALSE;
+    return LinkElem(list, new_elem, list->anchor.prev);
+}
 
-    new_elem->obj = obj;
-    new_elem->next = elem->next;
-    new_elem->prev = elem;
+int My402ListPrependElem(My402List *list, My402ListElem *new_elem) {
+    if (new_elem == NULL) return FALSE;
+    return LinkElem(list, new_elem, &(list->anchor));
+}
 
-    elem->next->prev = new_elem;
-    elem->next = new_elem;
+int My402ListInsertElemBefore(My402List *list, My402ListElem *new_elem, My402ListElem *elem) {
+    if (elem == NULL) {
+        return My402ListPrependElem(list, new_elem);
+    }
+    if (new_elem == NULL) return FALSE;
+    return LinkElem(list, new_elem, elem->prev);
+}
 
-    list->num_members++;
-    return TRUE;
+int My402ListInsertElemAfter(My402List *list, My402ListElem *new_elem, My402ListElem *elem) {
+    if (elem == NULL) {
+        return My402ListAppendElem(list, new_elem);
+    }
+    if (new_elem == NULL) return FALSE;
+    return LinkElem(list, new_elem, elem);
 }
 
 My402ListElem *My402ListFirst(My402List *list) {
@@ -134,6 +351,22 @@ My402ListElem *My402ListPrev(My402List *list, My402ListElem *elem) {
 
 My402ListElem *My402ListFind(My402List *list, void *obj) {
     My402ListElem *elem = NULL;
+
+    if (list->index != NULL) {
+        // the answer unless obj is in the list more than once, then it
+        // has to be the first of them in list order
+        My402ListIndex *index = list->index;
+        int mask = index->num_slots - 1, repeated = FALSE;
+        for (int i = IndexHome(index, obj); index->slots[i] != NULL; i = (i + 1) & mask) {
+            if (index->slots[i]->obj != obj) continue;
+            if (elem != NULL) {
+                repeated = TRUE;
+                break;
+            }
+            elem = index->slots[i];
+        }
+        if (!repeated) return elem;
+    }
     for (elem = My402ListFirst(list); elem != NULL; elem = My402ListNext(list, elem)) {
         if (elem->obj == obj) return elem;
     }
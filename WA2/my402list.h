@@ -7,6 +7,7 @@
 #ifndef _MY402LIST_H_
 #define _MY402LIST_H_
 
+#include <stddef.h>
 #include "cs402.h"
 
 typedef struct tagMy402ListElem {
@@ -15,6 +16,24 @@ typedef struct tagMy402ListElem {
     struct tagMy402ListElem *prev;
 } My402ListElem;
 
+/*
+ * For intrusive lists: the element is embedded in the user struct as
+ * "member", get back to the struct from a My402ListElem pointer.
+ */
+#define My402ListEntry(elem, type, member) \
+    ((type *)((char *)(elem) - offsetof(type, member)))
+
+/* slab of elements handed out by a pooled list, chained through next */
+typedef struct tagMy402ListChunk {
+    struct tagMy402ListChunk *next;
+} My402ListChunk;
+
+/* open-addressing table of the elements by obj, see My402ListInitIndexed() */
+typedef struct tagMy402ListIndex {
+    int num_slots;  /* a power of 2, kept at least twice num_members */
+    My402ListElem *slots[];
+} My402ListIndex;
+
 typedef struct tagMy402List {
     int num_members;
     My402ListElem anchor;
@@ -36,6 +55,19 @@ typedef struct tagMy402List {
     My402ListElem *(*Prev)(struct tagMy402List *, My402ListElem *cur);
 
     My402ListElem *(*Find)(struct tagMy402List *, void *obj);
+
+    /* element pool, only used if the list was created with My402ListInitPool() */
+    int chunk_size;
+    My402ListChunk *chunks;
+    My402ListElem *free_elems;
+
+    /* set by My402ListInitIntrusive(), elements belong to the caller */
+    int intrusive;
+
+    /* set by My402ListInitIndexed(); the table is allocated with the first
+       element and freed by My402ListUnlinkAll() */
+    int indexed;
+    My402ListIndex *index;
 } My402List;
 
 extern int  My402ListLength(My402List*);
@@ -55,6 +87,16 @@ extern My402ListElem *My402ListPrev(My402List*, My402ListElem*);
 
 extern My402ListElem *My402ListFind(My402List*, void*);
 
+extern void My402ListSort(My402List*, int (*)(My402ListElem*, My402ListElem*));
+
+extern int  My402ListAppendElem(My402List*, My402ListElem*);
+extern int  My402ListPrependElem(My402List*, My402ListElem*);
+extern int  My402ListInsertElemAfter(My402List*, My402ListElem*, My402ListElem*);
+extern int  My402ListInsertElemBefore(My402List*, My402ListElem*, My402ListElem*);
+
 extern int My402ListInit(My402List*);
+extern int My402ListInitPool(My402List*, int);
+extern int My402ListInitIntrusive(My402List*);
+extern int My402ListInitIndexed(My402List*);
 
 #endif /*_MY402LIST_H_*/
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "cs402.h"
+#include "warmup2.h"
+
+/*
+ * Independent runs of the simulation (see sim.c) spread over the machine's
+ * cores.  Each run has its own EmulationStats and random stream, so the
+ * workers share nothing but the counter they take job numbers from.
+ */
+
+typedef struct {
+    int num_jobs;
+    int next_job;  // atomic
+    void (*job)(int, void*);
+    void *arg;
+} JobPool;
+
+static void *worker(void *param) {
+    JobPool *pool = (JobPool *)param;
+    int i = 0;
+
+    while ((i = __atomic_fetch_add(&pool->next_job, 1, __ATOMIC_RELAXED)) < pool->num_jobs) {
+        pool->job(i, pool->arg);
+    }
+    return NULL;
+}
+
+// Call job(i, arg) for i = 0 .. num_jobs - 1 on one thread per core and
+// return when all of them have.
+void run_parallel(int num_jobs, void (*job)(int, void*), void *arg) {
+    JobPool pool = { num_jobs, 0, job, arg };
+    long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int num_threads = num_cores < 1 ? 1 : (int)num_cores;
+
+    if (num_threads > num_jobs) num_threads = num_jobs;
+    if (num_threads <= 1) {
+        worker(&pool);
+        return;
+    }
+
+    pthread_t threads[num_threads];
+    int started = 0;
+    for (; started < num_threads; started++) {
+        if (pthread_create(&threads[started], NULL, worker, &pool) != 0) break;
+    }
+    if (started == 0) worker(&pool);
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+// splitmix64, so that neighbouring seeds still give unrelated streams
+uint64_t replication_seed(uint64_t seed, int i) {
+    uint64_t z = seed + (uint64_t)(i + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return z != 0 ? z : 1;
+}
+
+typedef struct {
+    EmulationParams *params;
+    uint64_t seed;
+    int num_metrics;
+    Metric *metrics;  // num_metrics per replication
+} Replications;
+
+static void replicate(int i, void *arg) {
+    Replications *reps = (Replications *)arg;
+    EmulationParams params = *reps->params;
+    EmulationStats stats;
+
+    params.seed = replication_seed(reps->seed, i);
+    if (!init_stats(&stats, params.num_servers)) {
+        fprintf(stderr, "Memory allocation failed for %d servers\n", params.num_servers);
+        exit(EXIT_FAILURE);
+    }
+    simulate(&params, &stats, NULL);
+    compute_metrics(&stats, &reps->metrics[(size_t)i * reps->num_metrics]);
+    free_stats(&stats);
+}
+
+// Two-sided 95% quantiles of Student's t for 1 to 30 degrees of freedom
+static const double t_975[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+};
+
+static double t_quantile(int df) {
+    if (df <= 30) return t_975[df - 1];
+    if (df <= 40) return 2.021;
+    if (df <= 60) return 2.000;
+    if (df <= 120) return 1.980;
+    return 1.960;
+}
+
+// Run num_reps replications of params with exponential inter-arrival and
+// service times and print the mean of each print_statistics() figure with
+// the half-width of its 95% confidence interval.  Replications where a
+// figure is N/A leave it out.
+void run_replications(EmulationParams *params, int num_reps, uint64_t seed) {
+    Replications reps;
+
+    reps.params = params;
+    reps.seed = seed;
+    reps.num_metrics = MAX_METRICS(params->num_servers);
+    reps.metrics = (Metric *)calloc((size_t)num_reps * reps.num_metrics, sizeof(Metric));
+    if (reps.metrics == NULL) {
+        fprintf(stderr, "Memory allocation failed for %d replications\n", num_reps);
+        exit(EXIT_FAILURE);
+    }
+
+    run_parallel(num_reps, replicate, &reps);
+
+    printf("\nStatistics over %d replications (mean +/- 95%% confidence interval):\n", num_reps);
+    for (int m = 0; m < reps.num_metrics; m++) {
+        double sum = 0.0, sum_squared = 0.0;
+        int n = 0;
+
+        for (int i = 0; i < num_reps; i++) {
+            double value = reps.metrics[(size_t)i * reps.num_metrics + m].value;
+            if (isnan(value)) continue;
+            sum += value;
+            sum_squared += value * value;
+            n++;
+        }
+
+        Metric *metric = &reps.metrics[m];
+        if (metric->new_group) printf("\n");
+        if (n == 0) {
+            printf("\t%s = N/A\n", metric->name);
+        } else if (n == 1) {
+            printf("\t%s = %.6g\n", metric->name, sum);
+        } else {
+            double mean = sum / n;
+            double variance = (sum_squared - n * mean * mean) / (n - 1);
+            double half_width = t_quantile(n - 1) * sqrt(variance > 0.0 ? variance : 0.0) / sqrt(n);
+            printf("\t%s = %.6g +/- %.3g\n", metric->name, mean, half_width);
+        }
+    }
+
+    free(reps.metrics);
+}
@@ -0,0 +1,186 @@
+/*
+ * serverbench: packets/second through Q2 against the number of servers,
+ * with zero service time so that only dispatching is measured.  One
+ * producer (the token thread's role) pushes every packet; the servers take
+ * them from a single list under one lock and condition variable, from
+ * per-server deques in FIFO order, or from per-server deques with work
+ * stealing (see dispatch.c).
+ *
+ *     ./serverbench [-n num_packets] [-reps reps] [servers ...]
+ *     ./serverbench -n 2000000 1 2 4 8 16 32 64
+ *
+ * Each figure is the median of reps runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "dispatch.h"
+
+typedef struct {
+    My402ListElem link;
+    long id;
+} BenchPacket;
+
+// the single global queue warmup2 used before dispatch.c
+static My402List global_Q2;
+static pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t global_cond = PTHREAD_COND_INITIALIZER;
+static int global_closed = FALSE;
+
+static Dispatcher Q2;
+
+enum { MODE_GLOBAL, MODE_FIFO, MODE_STEAL };
+static int use_global = FALSE;
+
+typedef struct {
+    int id;
+    long taken;
+} BenchServer;
+
+static double now_in_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1000000.0;
+}
+
+static My402ListElem *global_take() {
+    My402ListElem *elem = NULL;
+
+    pthread_mutex_lock(&global_lock);
+    while (My402ListEmpty(&global_Q2) && !global_closed) {
+        pthread_cond_wait(&global_cond, &global_lock);
+    }
+    elem = My402ListFirst(&global_Q2);
+    if (elem != NULL) My402ListUnlink(&global_Q2, elem);
+    pthread_mutex_unlock(&global_lock);
+    return elem;
+}
+
+static void *server(void *param) {
+    BenchServer *s = (BenchServer *)param;
+    My402ListElem *elem = NULL;
+
+    while ((elem = use_global ? global_take() : DispatchTake(&Q2, s->id)) != NULL) {
+        s->taken++;
+    }
+    return NULL;
+}
+
+// packets/second for num_servers servers
+static double run(BenchPacket *packets, int n, int num_servers, int mode) {
+    pthread_t threads[num_servers];
+    BenchServer servers[num_servers];
+    long taken = 0;
+
+    int global = mode == MODE_GLOBAL;
+
+    use_global = global;
+    global_closed = FALSE;
+    if (!My402ListInitIntrusive(&global_Q2) || !DispatchInit(&Q2, num_servers, mode == MODE_STEAL)) {
+        fprintf(stderr, "Error: Could not initialize queues\n");
+        exit(1);
+    }
+
+    double start = now_in_ms();
+    for (int i = 0; i < num_servers; i++) {
+        servers[i].id = i;
+        servers[i].taken = 0;
+        pthread_create(&threads[i], NULL, server, &servers[i]);
+    }
+    for (int i = 0; i < n; i++) {
+        if (global) {
+            pthread_mutex_lock(&global_lock);
+            My402ListAppendElem(&global_Q2, &packets[i].link);
+            pthread_cond_signal(&global_cond);
+            pthread_mutex_unlock(&global_lock);
+        } else {
+            DispatchPush(&Q2, &packets[i].link);
+        }
+    }
+    if (global) {
+        pthread_mutex_lock(&global_lock);
+        global_closed = TRUE;
+        pthread_cond_broadcast(&global_cond);
+        pthread_mutex_unlock(&global_lock);
+    } else {
+        DispatchClose(&Q2);
+    }
+    for (int i = 0; i < num_servers; i++) {
+        pthread_join(threads[i], NULL);
+        taken += servers[i].taken;
+    }
+    double elapsed = now_in_ms() - start;
+
+    if (taken != n) {
+        fprintf(stderr, "Error: %ld of %d packets served\n", taken, n);
+        exit(1);
+    }
+    DispatchDestroy(&Q2);
+    return n / (elapsed / 1000.0);
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median_run(BenchPacket *packets, int n, int num_servers, int mode, int reps) {
+    double rates[reps];
+
+    for (int i = 0; i < reps; i++) {
+        rates[i] = run(packets, n, num_servers, mode);
+    }
+    qsort(rates, reps, sizeof(double), compare_double);
+    return rates[reps / 2];
+}
+
+int main(int argc, char *argv[]) {
+    int n = 1000000, reps = 5;
+    int counts[32], num_runs = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            n = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-reps") == 0 && i + 1 < argc) {
+            reps = atoi(argv[++i]);
+        } else if (atoi(argv[i]) > 0 && num_runs < 32) {
+            counts[num_runs++] = atoi(argv[i]);
+        } else {
+            fprintf(stderr, "Usage: %s [-n num_packets] [-reps reps] [servers ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (num_runs == 0) {
+        int defaults[] = { 1, 2, 4, 8, 16, 32, 64 };
+        for (num_runs = 0; num_runs < 7; num_runs++) counts[num_runs] = defaults[num_runs];
+    }
+    if (n <= 0 || reps <= 0) {
+        fprintf(stderr, "Error: -n and -reps must be positive\n");
+        return 1;
+    }
+
+    BenchPacket *packets = (BenchPacket *)malloc((size_t)n * sizeof(BenchPacket));
+    if (packets == NULL) {
+        fprintf(stderr, "Error: Could not allocate %d packets\n", n);
+        return 1;
+    }
+    for (int i = 0; i < n; i++) {
+        packets[i].id = i + 1;
+    }
+
+    printf("%8s %12s %16s %16s %16s\n", "servers", "packets", "global pkts/s", "fifo pkts/s", "stealing pkts/s");
+    for (int r = 0; r < num_runs; r++) {
+        double global = median_run(packets, n, counts[r], MODE_GLOBAL, reps);
+        double fifo = median_run(packets, n, counts[r], MODE_FIFO, reps);
+        double stealing = median_run(packets, n, counts[r], MODE_STEAL, reps);
+        printf("%8d %12d %16.0f %16.0f %16.0f\n", counts[r], n, global, fifo, stealing);
+    }
+
+    free(packets);
+    return 0;
+}
@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "cs402.h"
+#include "my402list.h"
+#include "warmup2.h"
+
+/*
+ * The token bucket emulation as a discrete-event simulation: one thread, a
+ * virtual clock in microseconds and a heap of pending events instead of
+ * threads sleeping in usleep().  Packets move through Q1, the bucket, Q2
+ * and the servers exactly as in warmup2.c, and the trace has the same
+ * lines, so a run can be checked with analyze-trace.txt.
+ */
+
+enum { EVENT_DEPARTURE, EVENT_ARRIVAL, EVENT_TOKEN };
+
+// Events at the same time are handled in type order, then in the order
+// they were scheduled.
+typedef struct {
+    int64_t time;
+    int type;
+    int server;
+    uint64_t seq;
+} SimEvent;
+
+typedef struct SimPacket {
+    My402ListElem link;  // Q1 and Q2 are intrusive lists
+    int id;
+    int tokens_needed;
+    int service_time_ms;
+    int64_t arrival_time;
+    int64_t enter_Q2_time;
+    int64_t begin_service_time;
+} SimPacket;
+
+typedef struct {
+    EmulationParams *params;
+    EmulationStats *stats;
+    FILE *out;    // the trace, or NULL for none
+    FILE *trace;  // the tsfile in trace-driven mode
+
+    int64_t now;
+    SimEvent *heap;
+    int heap_size;
+    uint64_t next_seq;
+
+    int tokens;
+    int token_id;
+    int64_t token_interval;
+    uint64_t random;  // xorshift state when params->seed is set
+    SimPacket *arriving;  // the packet of the pending arrival event
+    int64_t last_arrival_time;
+    int arrivals_done;
+    My402List Q1, Q2;
+
+    SimPacket **in_service;  // what each server is doing, NULL if idle
+} Simulation;
+
+static double ms(int64_t usec) {
+    return usec / 1000.0;
+}
+
+static void OutOfMemory() {
+    fprintf(stderr, "Memory allocation failed in simulation\n");
+    exit(EXIT_FAILURE);
+}
+
+// xorshift64, uniform in [0, 1)
+static double NextUniform(Simulation *sim) {
+    uint64_t x = sim->random;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    sim->random = x;
+    return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double NextExponential(Simulation *sim, double rate) {
+    return -log(1.0 - NextUniform(sim)) / rate;
+}
+
+static int EventBefore(SimEvent *a, SimEvent *b) {
+    if (a->time != b->time) return a->time < b->time;
+    if (a->type != b->type) return a->type < b->type;
+    return a->seq < b->seq;
+}
+
+// There is at most one arrival, one token and one departure per server
+// pending, so the heap never grows past num_servers + 2.
+static void Schedule(Simulation *sim, int64_t time, int type, int server) {
+    int i = sim->heap_size++;
+    SimEvent ev = { time, type, server, sim->next_seq++ };
+
+    while (i > 0 && EventBefore(&ev, &sim->heap[(i - 1) / 2])) {
+        sim->heap[i] = sim->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    sim->heap[i] = ev;
+}
+
+static SimEvent NextEvent(Simulation *sim) {
+    SimEvent first = sim->heap[0], last = sim->heap[--sim->heap_size];
+    int i = 0;
+
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= sim->heap_size) break;
+        if (child + 1 < sim->heap_size && EventBefore(&sim->heap[child + 1], &sim->heap[child])) child++;
+        if (!EventBefore(&sim->heap[child], &last)) break;
+        sim->heap[i] = sim->heap[child];
+        i = child;
+    }
+    sim->heap[i] = last;
+    return first;
+}
+
+// Read or make up packet id and schedule its arrival, the way the arrival
+// thread sleeps for the inter-arrival time before each packet.  usleep()
+// takes whole microseconds, so deterministic times are rounded down the
+// same way here.  With a seed, inter-arrival and service times are drawn
+// with means 1/lambda and 1/mu instead, service to the nearest ms.
+static void ScheduleArrival(Simulation *sim, int id) {
+    EmulationParams *params = sim->params;
+    SimPacket *packet = (SimPacket *)malloc(sizeof(SimPacket));
+    int64_t inter_arrival_time = 0;
+
+    if (packet == NULL) OutOfMemory();
+    packet->id = id;
+    if (sim->trace != NULL) {
+        int inter_arrival_time_ms = 0;
+        if (fscanf(sim->trace, "%d%d%d", &inter_arrival_time_ms, &packet->tokens_needed, &packet->service_time_ms) != 3) {
+            fprintf(stderr, "Error reading trace file on line %d\n", id + 1);
+            exit(EXIT_FAILURE);
+        }
+        inter_arrival_time = (int64_t)inter_arrival_time_ms * 1000;
+    } else if (params->seed != 0) {
+        packet->tokens_needed = params->P;
+        packet->service_time_ms = (int)(NextExponential(sim, params->mu) * 1000 + 0.5);
+        inter_arrival_time = (int64_t)(NextExponential(sim, params->lambda) * 1000000);
+    } else {
+        packet->tokens_needed = params->P;
+        packet->service_time_ms = 1000 / params->mu;
+        inter_arrival_time = (int64_t)(1.0 / params->lambda * 1000000);
+    }
+    sim->arriving = packet;
+    Schedule(sim, sim->last_arrival_time + inter_arrival_time, EVENT_ARRIVAL, 0);
+}
+
+static void Arrival(Simulation *sim) {
+    EmulationStats *stats = sim->stats;
+    SimPacket *packet = sim->arriving;
+    double inter_arrival_time = ms(sim->now - sim->last_arrival_time);
+
+    sim->arriving = NULL;
+    packet->arrival_time = sim->now;
+    sim->last_arrival_time = sim->now;
+    stats->total_inter_arrival_time += inter_arrival_time;
+    stats->total_packets_arrived++;
+
+    if (packet->id < sim->params->num_packets) {
+        ScheduleArrival(sim, packet->id + 1);
+    } else {
+        sim->arrivals_done = TRUE;
+    }
+
+    if (packet->tokens_needed > sim->params->B) {
+        stats->total_packets_dropped++;
+        if (sim->out != NULL) {
+            fprintf(sim->out, "%012.3fms: p%d arrives, needs %d tokens, inter-arrival time = %.6gms, dropped\n",
+                    ms(sim->now), packet->id, packet->tokens_needed, inter_arrival_time);
+        }
+        free(packet);
+        return;
+    }
+    if (sim->out != NULL) {
+        fprintf(sim->out, "%012.3fms: p%d arrives, needs %d tokens, inter-arrival time = %.3fms\n",
+                ms(sim->now), packet->id, packet->tokens_needed, inter_arrival_time);
+        fprintf(sim->out, "%012.3fms: p%d enters Q1\n", ms(sim->now), packet->id);
+    }
+    My402ListAppendElem(&sim->Q1, &packet->link);
+}
+
+// A token arrives, then as many packets as it allows move from Q1 to Q2.
+// Like the token thread, this stops once all packets have arrived and Q1
+// is empty.
+static void Token(Simulation *sim) {
+    EmulationStats *stats = sim->stats;
+    int B = sim->params->B;
+
+    stats->total_tokens_generated++;
+    if (sim->tokens < B) {
+        sim->tokens++;
+        if (sim->out != NULL) {
+            fprintf(sim->out, "%012.3fms: token t%d arrives, token bucket now has %d %s\n",
+                    ms(sim->now), sim->token_id, sim->tokens, sim->tokens > 1 ? "tokens" : "token");
+        }
+    } else {
+        stats->total_tokens_dropped++;
+        if (sim->out != NULL) {
+            fprintf(sim->out, "%012.3fms: token t%d arrives, dropped\n", ms(sim->now), sim->token_id);
+        }
+    }
+    sim->token_id++;
+
+    while (!My402ListEmpty(&sim->Q1)) {
+        My402ListElem *elem = My402ListFirst(&sim->Q1);
+        SimPacket *packet = My402ListEntry(elem, SimPacket, link);
+        if (packet->tokens_needed > sim->tokens) break;
+
+        sim->tokens -= packet->tokens_needed;
+        My402ListUnlink(&sim->Q1, elem);
+        stats->total_time_in_Q1 += ms(sim->now - packet->arrival_time);
+        if (sim->out != NULL) {
+            fprintf(sim->out, "%012.3fms: p%d leaves Q1, time in Q1 = %.3fms, token bucket now has %d %s\n",
+                    ms(sim->now), packet->id, ms(sim->now - packet->arrival_time),
+                    sim->tokens, sim->tokens > 1 ? "tokens" : "token");
+            fprintf(sim->out, "%012.3fms: p%d enters Q2\n", ms(sim->now), packet->id);
+        }
+        packet->enter_Q2_time = sim->now;
+        My402ListAppendElem(&sim->Q2, &packet->link);
+    }
+
+    if (!sim->arrivals_done || !My402ListEmpty(&sim->Q1)) {
+        Schedule(sim, sim->now + sim->token_interval, EVENT_TOKEN, 0);
+    }
+}
+
+static void Departure(Simulation *sim, int server) {
+    ServerStats *stats = &sim->stats->servers[server];
+    SimPacket *packet = sim->in_service[server];
+    double service_time = ms(sim->now - packet->begin_service_time);
+    double time_in_system = ms(sim->now - packet->arrival_time);
+
+    sim->in_service[server] = NULL;
+    stats->packets_served++;
+    stats->service_time += service_time;
+    stats->time_in_system += time_in_system;
+    stats->system_time_squared += time_in_system * time_in_system;
+    if (sim->out != NULL) {
+        fprintf(sim->out, "%012.3fms: p%d departs from S%d, service time = %.3fms, time in system = %.3fms\n",
+                ms(sim->now), packet->id, server + 1, service_time, time_in_system);
+    }
+    free(packet);
+}
+
+// Idle servers take packets from Q2, the lowest numbered server first.
+static void StartService(Simulation *sim) {
+    for (int server = 0; server < sim->params->num_servers && !My402ListEmpty(&sim->Q2); server++) {
+        if (sim->in_service[server] != NULL) continue;
+
+        My402ListElem *elem = My402ListFirst(&sim->Q2);
+        SimPacket *packet = My402ListEntry(elem, SimPacket, link);
+        My402ListUnlink(&sim->Q2, elem);
+
+        sim->stats->servers[server].time_in_Q2 += ms(sim->now - packet->enter_Q2_time);
+        if (sim->out != NULL) {
+            fprintf(sim->out, "%012.3fms: p%d leaves Q2, time in Q2 = %.3fms\n",
+                    ms(sim->now), packet->id, ms(sim->now - packet->enter_Q2_time));
+            fprintf(sim->out, "%012.3fms: p%d begins service at S%d, requesting %dms of service\n",
+                    ms(sim->now), packet->id, server + 1, packet->service_time_ms);
+        }
+        packet->begin_service_time = sim->now;
+        sim->in_service[server] = packet;
+        Schedule(sim, sim->now + (int64_t)packet->service_time_ms * 1000, EVENT_DEPARTURE, server);
+    }
+}
+
+// Run params to the end, adding to stats (set up by init_stats() for
+// params->num_servers) and writing the trace to out unless it is NULL.
+// Tokens always come every 1/r seconds; params->seed, if not 0, only
+// randomizes the packets in deterministic mode.  Nothing here is shared,
+// so several simulations can run at once on different threads.
+void simulate(EmulationParams *params, EmulationStats *stats, FILE *out) {
+    Simulation sim;
+
+    memset(&sim, 0, sizeof(sim));
+    sim.params = params;
+    sim.stats = stats;
+    sim.out = out;
+    sim.token_id = 1;
+    sim.token_interval = (int64_t)(1.0 / params->r * 1000000);
+    sim.random = params->seed;
+    sim.heap = (SimEvent *)malloc((params->num_servers + 2) * sizeof(SimEvent));
+    sim.in_service = (SimPacket **)calloc(params->num_servers, sizeof(SimPacket *));
+    if (sim.heap == NULL || sim.in_service == NULL) OutOfMemory();
+    My402ListInitIntrusive(&sim.Q1);
+    My402ListInitIntrusive(&sim.Q2);
+
+    if (params->tracefile != NULL) {
+        int num_packets_from_trace = 0;
+        sim.trace = fopen(params->tracefile, "r");
+        if (sim.trace == NULL) {
+            perror("Error opening trace file");
+            exit(EXIT_FAILURE);
+        }
+        if (fscanf(sim.trace, "%d", &num_packets_from_trace) != 1) {
+            fprintf(stderr, "Error reading the number of packets from trace file\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (params->num_packets > 0) {
+        ScheduleArrival(&sim, 1);
+        Schedule(&sim, sim.token_interval, EVENT_TOKEN, 0);
+    }
+    while (sim.heap_size > 0) {
+        SimEvent ev = NextEvent(&sim);
+        sim.now = ev.time;
+        switch (ev.type) {
+        case EVENT_ARRIVAL: Arrival(&sim); break;
+        case EVENT_TOKEN: Token(&sim); break;
+        case EVENT_DEPARTURE: Departure(&sim, ev.server); break;
+        }
+        StartService(&sim);
+    }
+
+    stats->emulation_time_ms = ms(sim.now);
+    if (out != NULL) fprintf(out, "%012.3fms: emulation ends\n", ms(sim.now));
+
+    if (sim.trace != NULL) fclose(sim.trace);
+    free(sim.heap);
+    free(sim.in_service);
+}
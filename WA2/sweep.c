@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include "cs402.h"
+#include "warmup2.h"
+
+/*
+ * Parameter sweeps: every combination of the values given for -lambda,
+ * -mu, -r, -B and -P is simulated (see sim.c), the grid points in parallel
+ * on run_parallel()'s workers, and each point's print_statistics() figures
+ * become one row of a CSV or TSV file.
+ */
+
+// Whether a value is allowed: a count (B, P) from 0 to INT_MAX, or a rate
+// (lambda, mu, r) above 0.
+static int valid_value(double value, int is_count) {
+    if (is_count) return value >= 0.0 && value <= INT_MAX;
+    return value > 0.0 && isfinite(value);
+}
+
+// A value, start:stop:step, or a comma separated list of values.  stop is
+// included when the steps land on it.  Fails on values that valid_value()
+// rejects and on more than MAX_SWEEP_POINTS of them.
+int parse_range(const char *arg, SweepRange *range, int is_count) {
+    double start = 0.0, stop = 0.0, step = 0.0, steps = 0.0;
+    char end = '\0';
+    int count = 0;
+
+    free(range->values);
+    range->values = NULL;
+    range->count = 0;
+
+    if (sscanf(arg, "%lf:%lf:%lf%c", &start, &stop, &step, &end) == 3) {
+        if (!(step > 0.0) || !(stop >= start)) return FALSE;
+        if (!valid_value(start, is_count) || !valid_value(stop, is_count)) return FALSE;
+        // allow for rounding, e.g. 0.1:0.3:0.1
+        steps = floor((stop - start) / step + 1e-9);
+        if (!(steps < MAX_SWEEP_POINTS)) return FALSE;
+        count = (int)steps + 1;
+        range->values = (double *)malloc(count * sizeof(double));
+        if (range->values == NULL) return FALSE;
+        for (int i = 0; i < count; i++) {
+            range->values[i] = start + i * step;
+        }
+        range->count = count;
+        return TRUE;
+    }
+
+    count = 1;
+    for (const char *c = arg; *c != '\0'; c++) {
+        if (*c == ',') count++;
+    }
+    if (count > MAX_SWEEP_POINTS) return FALSE;
+    range->values = (double *)malloc(count * sizeof(double));
+    if (range->values == NULL) return FALSE;
+    for (const char *c = arg; range->count < count; c++) {
+        char *next = NULL;
+        range->values[range->count++] = strtod(c, &next);
+        if (next == c || (*next != ',' && *next != '\0')) return FALSE;
+        if (!valid_value(range->values[range->count - 1], is_count)) return FALSE;
+        c = next;
+    }
+    return TRUE;
+}
+
+typedef struct {
+    EmulationParams *base;
+    SweepRange *ranges;  // NUM_SWEEP_PARAMS of them
+    int num_reps;
+    uint64_t seed;
+    int num_metrics;
+    Metric *metrics;     // num_metrics per grid point
+} Sweep;
+
+// Grid point i, counting with P changing fastest and lambda slowest
+static EmulationParams grid_point(Sweep *sweep, int i) {
+    EmulationParams params = *sweep->base;
+    double values[NUM_SWEEP_PARAMS];
+
+    for (int k = NUM_SWEEP_PARAMS - 1; k >= 0; k--) {
+        values[k] = sweep->ranges[k].values[i % sweep->ranges[k].count];
+        i /= sweep->ranges[k].count;
+    }
+    params.lambda = values[SWEEP_LAMBDA];
+    params.mu = values[SWEEP_MU];
+    params.r = values[SWEEP_R];
+    params.B = (int)lround(values[SWEEP_B]);
+    params.P = (int)lround(values[SWEEP_P]);
+    return params;
+}
+
+// One deterministic run, or with num_reps the mean of that many randomized
+// ones, where a figure that is N/A in some runs is averaged over the rest.
+static void sweep_point(int i, void *arg) {
+    Sweep *sweep = (Sweep *)arg;
+    EmulationParams params = grid_point(sweep, i);
+    Metric *metrics = &sweep->metrics[(size_t)i * sweep->num_metrics];
+    double sums[sweep->num_metrics];
+    int counts[sweep->num_metrics];
+    int num_runs = sweep->num_reps > 0 ? sweep->num_reps : 1;
+
+    memset(sums, 0, sizeof(sums));
+    memset(counts, 0, sizeof(counts));
+    for (int rep = 0; rep < num_runs; rep++) {
+        EmulationStats stats;
+
+        if (sweep->num_reps > 0) params.seed = replication_seed(sweep->seed, i * num_runs + rep);
+        if (!init_stats(&stats, params.num_servers)) {
+            fprintf(stderr, "Memory allocation failed for %d servers\n", params.num_servers);
+            exit(EXIT_FAILURE);
+        }
+        simulate(&params, &stats, NULL);
+        compute_metrics(&stats, metrics);
+        free_stats(&stats);
+
+        for (int m = 0; m < sweep->num_metrics; m++) {
+            if (isnan(metrics[m].value)) continue;
+            sums[m] += metrics[m].value;
+            counts[m]++;
+        }
+    }
+    for (int m = 0; m < sweep->num_metrics; m++) {
+        metrics[m].value = counts[m] > 0 ? sums[m] / counts[m] : NAN;
+    }
+}
+
+// Simulate every grid point of ranges around base and write a header and
+// one row per point to out, fields separated by separator.  N/A figures
+// are left empty.  Returns the number of grid points.
+int run_sweep(EmulationParams *base, SweepRange *ranges, int num_reps, uint64_t seed, FILE *out, char separator) {
+    static const char *param_names[NUM_SWEEP_PARAMS] = { "lambda", "mu", "r", "B", "P" };
+    Sweep sweep;
+    int num_points = 1;
+
+    for (int k = 0; k < NUM_SWEEP_PARAMS; k++) {
+        num_points *= ranges[k].count;
+    }
+    sweep.base = base;
+    sweep.ranges = ranges;
+    sweep.num_reps = num_reps;
+    sweep.seed = seed;
+    sweep.num_metrics = MAX_METRICS(base->num_servers);
+    sweep.metrics = (Metric *)calloc((size_t)num_points * sweep.num_metrics, sizeof(Metric));
+    if (sweep.metrics == NULL) {
+        fprintf(stderr, "Memory allocation failed for %d grid points\n", num_points);
+        exit(EXIT_FAILURE);
+    }
+
+    run_parallel(num_points, sweep_point, &sweep);
+
+    for (int k = 0; k < NUM_SWEEP_PARAMS; k++) {
+        fprintf(out, "%s%c", param_names[k], separator);
+    }
+    for (int m = 0; m < sweep.num_metrics; m++) {
+        fprintf(out, "%s%c", sweep.metrics[m].name, m + 1 < sweep.num_metrics ? separator : '\n');
+    }
+    for (int i = 0; i < num_points; i++) {
+        EmulationParams params = grid_point(&sweep, i);
+        Metric *metrics = &sweep.metrics[(size_t)i * sweep.num_metrics];
+
+        fprintf(out, "%.6g%c%.6g%c%.6g%c%d%c%d%c", params.lambda, separator, params.mu, separator,
+                params.r, separator, params.B, separator, params.P, separator);
+        for (int m = 0; m < sweep.num_metrics; m++) {
+            if (!isnan(metrics[m].value)) fprintf(out, "%.6g", metrics[m].value);
+            fputc(m + 1 < sweep.num_metrics ? separator : '\n', out);
+        }
+    }
+
+    free(sweep.metrics);
+    return num_points;
+}
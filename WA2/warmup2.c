@@ -9,24 +9,16 @@
 #include <stdint.h>  
 #include <signal.h>
 #include "my402list.h"
+#include "dispatch.h"
+#include "warmup2.h"
 
-double total_inter_arrival_time = 0.0;
-double total_service_time = 0.0;
-double total_time_in_Q1 = 0.0;
-double total_time_in_Q2 = 0.0;
-double total_time_in_S1 = 0.0;
-double total_time_in_S2 = 0.0;
-double total_time_in_system = 0.0;
-double total_system_time_squared = 0.0;
-
-int total_packets_arrived = 0;
-int total_packets_served = 0;
-int total_packets_dropped = 0;
-int total_tokens_generated = 0;
-int total_tokens_dropped = 0;
+// The totals are updated by the arrival and token threads, each server only
+// updates its own stats.servers[] entry.
+EmulationStats stats;
 
 // Structure to represent packets
 typedef struct Packet {
+    My402ListElem link;  // Q1 and Q2 are intrusive lists
     int id;
     int tokens_needed;
     int service_time_ms;
@@ -44,8 +36,12 @@ int bucket_capacity = 10;
 int tokens = 0;
 pthread_mutex_t token_lock = PTHREAD_MUTEX_INITIALIZER;
 
-// Queues for Q1 and Q2
-My402List Q1, Q2;
+// Q1 is guarded by queue_lock.  Q2 is split into one deque per server
+// with its own locks, idle servers sleep in DispatchTake() and wake up
+// when the token thread pushes a packet or closes Q2.  Packets leave Q2 in
+// the order they entered it unless -steal is given.
+My402List Q1;
+Dispatcher Q2;
 pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
 
 // Global parameters
@@ -55,7 +51,13 @@ double r = 1.5;
 int B = 10;
 int P = 3;
 int num_packets = 20;
+int num_servers = 2;
+int steal = 0;               // -steal: servers steal work, Q2 is not FIFO
 int deterministic_mode = 1;  // Default is deterministic mode
+int simulated = 0;           // -sim: run on a virtual clock, see sim.c
+int num_reps = 0;            // -reps: simulated replications, see replicate.c
+unsigned long long seed = 402;
+const char *sweep_file = NULL;  // -sweep: CSV or TSV of a parameter grid, see sweep.c
 char tracefile[256] = {0};
 
 // Emulation start time
@@ -70,31 +72,40 @@ void *server_thread(void *param);
 void parse_trace_file(const char *filename);
 void *parse_trace_file_thread(void *param);
 double get_elapsed_time_in_ms(struct timeval *start, struct timeval *end);
-void print_statistics();
 
 void *sigint_handler_thread(void *arg);
 void remove_packets_from_queue(My402List *queue);
+int no_more_packets_for_Q2();
+void leave_Q2(My402ListElem *elem, int server);
 
 // Thread
-pthread_t packet_thread, token_thread, server1, server2, sigint_thread;
+pthread_t packet_thread, token_thread, sigint_thread;
+pthread_t *server_threads;
 sigset_t set;
 
 int main(int argc, char *argv[]) {
+    const char *range_args[NUM_SWEEP_PARAMS] = { NULL };
+
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-lambda") == 0 && i + 1 < argc) {
             lambda = atof(argv[i + 1]);
+            range_args[SWEEP_LAMBDA] = argv[i + 1];
             i++; 
         } else if (strcmp(argv[i], "-mu") == 0 && i + 1 < argc) {
             mu = atof(argv[i + 1]);
+            range_args[SWEEP_MU] = argv[i + 1];
             i++;
         } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
             r = atof(argv[i + 1]);
+            range_args[SWEEP_R] = argv[i + 1];
             i++;
         } else if (strcmp(argv[i], "-B") == 0 && i + 1 < argc) {
             B = atoi(argv[i + 1]);
+            range_args[SWEEP_B] = argv[i + 1];
             i++;
         } else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
             P = atoi(argv[i + 1]);
+            range_args[SWEEP_P] = argv[i + 1];
             i++;
         } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
             num_packets = atoi(argv[i + 1]);
@@ -103,16 +114,49 @@ int main(int argc, char *argv[]) {
             strncpy(tracefile, argv[i + 1], sizeof(tracefile) - 1);
             deterministic_mode = 0;  // Switch to trace-driven mode
             i++;
+        } else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            num_servers = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-steal") == 0) {
+            steal = 1;
+        } else if (strcmp(argv[i], "-sim") == 0) {
+            simulated = 1;
+        } else if (strcmp(argv[i], "-reps") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            num_reps = atoi(argv[i + 1]);
+            i++;
+        } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[i + 1], NULL, 10);
+            i++;
+        } else if (strcmp(argv[i], "-sweep") == 0 && i + 1 < argc) {
+            sweep_file = argv[i + 1];
+            i++;
         } else {
-            fprintf(stderr, "Usage: %s [-lambda lambda] [-mu mu] [-r r] [-B B] [-P P] [-n num] [-t tsfile]\n", argv[0]);
+            fprintf(stderr, "Usage: %s [-lambda lambda] [-mu mu] [-r r] [-B B] [-P P] [-n num] [-t tsfile] [-S num_servers] [-steal] [-sim] [-reps k [-seed seed]] [-sweep file.csv|file.tsv|-]\n", argv[0]);
+            fprintf(stderr, "       with -sweep, -lambda, -mu, -r, -B and -P also take start:stop:step or a,b,c\n");
             exit(EXIT_FAILURE);
         }
     }
+    for (int k = 0; k < NUM_SWEEP_PARAMS && sweep_file == NULL; k++) {
+        if (range_args[k] != NULL && strpbrk(range_args[k], ":,") != NULL) {
+            fprintf(stderr, "Error: ranges of parameters need -sweep\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (num_reps > 0 && !deterministic_mode) {
+        fprintf(stderr, "Error: -reps randomizes deterministic mode and cannot be used with -t\n");
+        exit(EXIT_FAILURE);
+    }
 
-    if (My402ListInit(&Q1) != 1 || My402ListInit(&Q2) != 1) {
+    if (My402ListInitIntrusive(&Q1) != 1 || DispatchInit(&Q2, num_servers, steal) != 1) {
         fprintf(stderr, "Failed to initialize queues\n");
         exit(EXIT_FAILURE);
     }
+    Q2.on_take = leave_Q2;
+    server_threads = (pthread_t *)malloc(num_servers * sizeof(pthread_t));
+    if (server_threads == NULL || !init_stats(&stats, num_servers)) {
+        fprintf(stderr, "Memory allocation failed for %d servers\n", num_servers);
+        exit(EXIT_FAILURE);
+    }
 
     gettimeofday(&emulation_start, NULL);
 
@@ -120,6 +164,56 @@ int main(int argc, char *argv[]) {
         parse_trace_file(tracefile);
     }
 
+    if (sweep_file != NULL) {
+        EmulationParams params = { lambda, mu, r, B, P, num_packets, num_servers,
+                                   deterministic_mode ? NULL : tracefile };
+        double defaults[NUM_SWEEP_PARAMS] = { lambda, mu, r, B, P };
+        SweepRange ranges[NUM_SWEEP_PARAMS];
+        int to_stdout = strcmp(sweep_file, "-") == 0;
+        size_t len = strlen(sweep_file);
+        char separator = len > 4 && strcmp(sweep_file + len - 4, ".tsv") == 0 ? '\t' : ',';
+
+        int num_points = 1;
+
+        memset(ranges, 0, sizeof(ranges));
+        for (int k = 0; k < NUM_SWEEP_PARAMS; k++) {
+            if (range_args[k] == NULL) {
+                ranges[k].values = (double *)malloc(sizeof(double));
+                if (ranges[k].values == NULL) {
+                    fprintf(stderr, "Memory allocation failed for sweep\n");
+                    exit(EXIT_FAILURE);
+                }
+                ranges[k].values[0] = defaults[k];
+                ranges[k].count = 1;
+            } else if (!parse_range(range_args[k], &ranges[k], k == SWEEP_B || k == SWEEP_P)) {
+                fprintf(stderr, "Error: bad range \"%s\", use a value, start:stop:step or a,b,c\n", range_args[k]);
+                exit(EXIT_FAILURE);
+            }
+            if (num_points > MAX_SWEEP_POINTS / ranges[k].count) {
+                fprintf(stderr, "Error: sweep has more than %d grid points\n", MAX_SWEEP_POINTS);
+                exit(EXIT_FAILURE);
+            }
+            num_points *= ranges[k].count;
+        }
+
+        FILE *out = to_stdout ? stdout : fopen(sweep_file, "w");
+        if (out == NULL) {
+            perror("Error opening sweep file");
+            exit(EXIT_FAILURE);
+        }
+        num_points = run_sweep(&params, ranges, num_reps, seed, out, separator);
+        if (!to_stdout) {
+            fclose(out);
+            printf("%d grid points written to %s\n", num_points, sweep_file);
+        }
+
+        for (int k = 0; k < NUM_SWEEP_PARAMS; k++) {
+            free(ranges[k].values);
+        }
+        free_stats(&stats);
+        return 0;
+    }
+
     printf("Emulation Parameters:\n");
     printf("    number to arrive = %d\n", num_packets);
     if (deterministic_mode) {
@@ -133,8 +227,25 @@ int main(int argc, char *argv[]) {
         printf("    tsfile = %s\n", tracefile);
     }
 
+    if (num_reps > 0) {
+        EmulationParams params = { lambda, mu, r, B, P, num_packets, num_servers, NULL };
+        printf("    replications = %d, seed = %llu\n", num_reps, seed);
+        run_replications(&params, num_reps, seed);
+        free_stats(&stats);
+        return 0;
+    }
+
     printf("\n%08d.%03dms: emulation begins\n", 0, 0);
 
+    if (simulated) {
+        EmulationParams params = { lambda, mu, r, B, P, num_packets, num_servers,
+                                   deterministic_mode ? NULL : tracefile };
+        simulate(&params, &stats, stdout);
+        print_statistics(&stats);
+        free_stats(&stats);
+        return 0;
+    }
+
     sigemptyset(&set);
     sigaddset(&set, SIGINT);
     if (pthread_sigmask(SIG_BLOCK, &set, NULL) != 0) {
@@ -164,36 +275,37 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    if (pthread_create(&server1, NULL, server_thread, (void *)(intptr_t)1) != 0) {
-        perror("Failed to create server 1 thread");
-        exit(EXIT_FAILURE);
-    }
-
-    if (pthread_create(&server2, NULL, server_thread, (void *)(intptr_t)2) != 0) {
-        perror("Failed to create server 2 thread");
-        exit(EXIT_FAILURE);
+    for (int i = 0; i < num_servers; i++) {
+        if (pthread_create(&server_threads[i], NULL, server_thread, (void *)(intptr_t)(i + 1)) != 0) {
+            fprintf(stderr, "Failed to create server %d thread\n", i + 1);
+            exit(EXIT_FAILURE);
+        }
     }
 
     pthread_join(packet_thread, NULL);
 
     pthread_mutex_lock(&queue_lock);
     is_emulation_finished = 1; 
+    if (no_more_packets_for_Q2()) DispatchClose(&Q2);
     pthread_mutex_unlock(&queue_lock);
 
     pthread_join(token_thread, NULL);
-    pthread_join(server1, NULL);
-    pthread_join(server2, NULL);
+    for (int i = 0; i < num_servers; i++) {
+        pthread_join(server_threads[i], NULL);
+    }
 
     gettimeofday(&emulation_end, NULL);
-    double termination_time_ms = get_elapsed_time_in_ms(&emulation_start, &emulation_end);
-    printf("%012.3fms: emulation ends\n", termination_time_ms);
+    stats.emulation_time_ms = get_elapsed_time_in_ms(&emulation_start, &emulation_end);
+    printf("%012.3fms: emulation ends\n", stats.emulation_time_ms);
 
-    print_statistics();
+    print_statistics(&stats);
 
     pthread_mutex_destroy(&token_lock);
     pthread_mutex_destroy(&queue_lock);
     My402ListUnlinkAll(&Q1);
-    My402ListUnlinkAll(&Q2);
+    DispatchDestroy(&Q2);
+    free(server_threads);
+    free_stats(&stats);
 
     return 0;
 }
@@ -216,11 +328,11 @@ void *packet_arrival_thread(void *param) {
         double inter_arrival_time = get_elapsed_time_in_ms(&last_arrival_time, &packet->arrival_time);
         last_arrival_time = packet->arrival_time;
 
-        total_inter_arrival_time += inter_arrival_time;
-        total_packets_arrived++;
+        stats.total_inter_arrival_time += inter_arrival_time;
+        stats.total_packets_arrived++;
 
         if (packet->tokens_needed > B) {
-            total_packets_dropped++;
+            stats.total_packets_dropped++;
             printf("%012.3fms: p%d arrives, needs %d tokens, inter-arrival time = %.6gms, dropped\n",
                    get_elapsed_time_in_ms(&emulation_start, &packet->arrival_time),
                    packet->id, packet->tokens_needed, inter_arrival_time);
@@ -231,7 +343,7 @@ void *packet_arrival_thread(void *param) {
                get_elapsed_time_in_ms(&emulation_start, &packet->arrival_time), i, P, inter_arrival_time);
 
         pthread_mutex_lock(&queue_lock);
-        if (My402ListAppend(&Q1, packet) != 1) {
+        if (My402ListAppendElem(&Q1, &packet->link) != 1) {
             fprintf(stderr, "Failed to append packet to Q1\n");
             pthread_mutex_unlock(&queue_lock);
             exit(EXIT_FAILURE);
@@ -244,11 +356,16 @@ void *packet_arrival_thread(void *param) {
 
 void *token_deposit_thread(void *param) {
     int token_id = 1;
-    while (!is_emulation_finished || !My402ListEmpty(&Q1)) {
+    for (;;) {
+        pthread_mutex_lock(&queue_lock);
+        int done = is_emulation_finished && My402ListEmpty(&Q1);
+        pthread_mutex_unlock(&queue_lock);
+        if (done) break;
+
         usleep((useconds_t)(1.0 / r * 1000000));
 
         pthread_mutex_lock(&token_lock);
-        total_tokens_generated++;
+        stats.total_tokens_generated++;
         if (tokens < B) {
             tokens++;
             struct timeval token_arrival_time;
@@ -261,7 +378,7 @@ void *token_deposit_thread(void *param) {
             gettimeofday(&token_arrival_time, NULL);
             printf("%012.3fms: token t%d arrives, dropped\n",
                    get_elapsed_time_in_ms(&emulation_start, &token_arrival_time), token_id++);
-            total_tokens_dropped++;
+            stats.total_tokens_dropped++;
         }
         pthread_mutex_unlock(&token_lock);
 
@@ -269,19 +386,14 @@ void *token_deposit_thread(void *param) {
         pthread_mutex_lock(&queue_lock);
         while (!My402ListEmpty(&Q1)) {
             My402ListElem *elem = My402ListFirst(&Q1);
-            Packet *packet = (Packet *)elem->obj;
+            Packet *packet = My402ListEntry(elem, Packet, link);
             if (packet->tokens_needed <= tokens) {
                 tokens -= packet->tokens_needed;
                 struct timeval leave_Q1_time;
                 gettimeofday(&leave_Q1_time, NULL);
                 My402ListUnlink(&Q1, elem);
-                total_time_in_Q1 += get_elapsed_time_in_ms(&packet->arrival_time, &leave_Q1_time);
+                stats.total_time_in_Q1 += get_elapsed_time_in_ms(&packet->arrival_time, &leave_Q1_time);
 
-                if (My402ListAppend(&Q2, packet) != 1) {
-                    fprintf(stderr, "Failed to append packet to Q2\n");
-                    pthread_mutex_unlock(&queue_lock);
-                    exit(EXIT_FAILURE);
-                }
                 printf("%012.3fms: p%d leaves Q1, time in Q1 = %.3fms, token bucket now has %d %s\n",
                     get_elapsed_time_in_ms(&emulation_start, &leave_Q1_time),
                     packet->id, get_elapsed_time_in_ms(&packet->arrival_time, &leave_Q1_time),
@@ -289,67 +401,67 @@ void *token_deposit_thread(void *param) {
 
                 gettimeofday(&packet->enter_Q2_time, NULL);
                 printf("%012.3fms: p%d enters Q2\n", get_elapsed_time_in_ms(&emulation_start, &packet->enter_Q2_time), packet->id);
+                DispatchPush(&Q2, &packet->link);
             } else {
-                // total_packets_dropped++;
+                // stats.total_packets_dropped++;
                 break;
             }
         }
+        // Q1 may just have been drained for good
+        if (no_more_packets_for_Q2()) DispatchClose(&Q2);
         pthread_mutex_unlock(&queue_lock);
     }
     return NULL;
 }
 
+// Call with queue_lock held.  Once this is true Q2 can be closed, servers
+// that find it empty then quit.
+int no_more_packets_for_Q2() {
+    return is_emulation_finished && My402ListEmpty(&Q1);
+}
+
+// Q2's on_take, so that packets leave Q2 and begin service in order
+void leave_Q2(My402ListElem *elem, int server) {
+    Packet *packet = My402ListEntry(elem, Packet, link);
+
+    gettimeofday(&packet->leave_Q2_time, NULL);
+    stats.servers[server].time_in_Q2 += get_elapsed_time_in_ms(&packet->enter_Q2_time, &packet->leave_Q2_time);
+    printf("%012.3fms: p%d leaves Q2, time in Q2 = %.3fms\n",
+        get_elapsed_time_in_ms(&emulation_start, &packet->leave_Q2_time),
+        packet->id,
+        get_elapsed_time_in_ms(&packet->enter_Q2_time, &packet->leave_Q2_time));
+    gettimeofday(&packet->begin_service_time, NULL);
+    printf("%012.3fms: p%d begins service at S%d, requesting %dms of service\n",
+           get_elapsed_time_in_ms(&emulation_start, &packet->begin_service_time),
+           packet->id, server + 1, packet->service_time_ms);
+}
+
 void *server_thread(void *param) {
     intptr_t server_id = (intptr_t)param;
-    while (!is_emulation_finished || !My402ListEmpty(&Q2) || !My402ListEmpty(&Q1)) {
-        pthread_mutex_lock(&queue_lock);
-        if (!My402ListEmpty(&Q2)) {
-            My402ListElem *elem = My402ListFirst(&Q2);
-            Packet *packet = (Packet *)elem->obj;
-            My402ListUnlink(&Q2, elem);
-
-            struct timeval leave_Q2_time;
-            gettimeofday(&leave_Q2_time, NULL);
-
-            total_time_in_Q2 += get_elapsed_time_in_ms(&packet->enter_Q2_time, &leave_Q2_time);
-            printf("%012.3fms: p%d leaves Q2, time in Q2 = %.3fms\n",
-                get_elapsed_time_in_ms(&emulation_start, &leave_Q2_time),
-                packet->id,
-                get_elapsed_time_in_ms(&packet->enter_Q2_time, &leave_Q2_time));
-            struct timeval begin_service_time;
-            gettimeofday(&begin_service_time, NULL);
-            printf("%012.3fms: p%d begins service at S%ld, requesting %dms of service\n",
-                   get_elapsed_time_in_ms(&emulation_start, &begin_service_time),
-                   packet->id, (long)server_id, packet->service_time_ms);
+    ServerStats *server = &stats.servers[server_id - 1];
+    My402ListElem *elem = NULL;
 
-            pthread_mutex_unlock(&queue_lock);
+    while ((elem = DispatchTake(&Q2, (int)server_id - 1)) != NULL) {
+        Packet *packet = My402ListEntry(elem, Packet, link);
+        struct timeval begin_service_time = packet->begin_service_time;
 
-            usleep(packet->service_time_ms * 1000);
-            struct timeval depart_time;
-            gettimeofday(&depart_time, NULL);
+        usleep(packet->service_time_ms * 1000);
+        struct timeval depart_time;
+        gettimeofday(&depart_time, NULL);
 
-            double time_in_system = get_elapsed_time_in_ms(&packet->arrival_time, &depart_time);
-            total_time_in_system += time_in_system;
-            total_system_time_squared += time_in_system * time_in_system;
+        double time_in_system = get_elapsed_time_in_ms(&packet->arrival_time, &depart_time);
+        server->time_in_system += time_in_system;
+        server->system_time_squared += time_in_system * time_in_system;
 
-            total_packets_served ++;
-            total_service_time += get_elapsed_time_in_ms(&begin_service_time, &depart_time);
-            if (server_id == 1){
-                total_time_in_S1 += get_elapsed_time_in_ms(&begin_service_time, &depart_time);
-            }else{
-                total_time_in_S2 += get_elapsed_time_in_ms(&begin_service_time, &depart_time);
-            }
-            printf("%012.3fms: p%d departs from S%ld, service time = %.3fms, time in system = %.3fms\n",
-                   get_elapsed_time_in_ms(&emulation_start, &depart_time),
-                   packet->id, (long)server_id,
-                   get_elapsed_time_in_ms(&begin_service_time, &depart_time),
-                   get_elapsed_time_in_ms(&packet->arrival_time, &depart_time));
+        server->packets_served++;
+        server->service_time += get_elapsed_time_in_ms(&begin_service_time, &depart_time);
+        printf("%012.3fms: p%d departs from S%ld, service time = %.3fms, time in system = %.3fms\n",
+               get_elapsed_time_in_ms(&emulation_start, &depart_time),
+               packet->id, (long)server_id,
+               get_elapsed_time_in_ms(&begin_service_time, &depart_time),
+               get_elapsed_time_in_ms(&packet->arrival_time, &depart_time));
 
-            free(packet);
-        } else {
-            pthread_mutex_unlock(&queue_lock);
-            usleep(1000);
-        }
+        free(packet);
     }
     return NULL;
 }
@@ -409,11 +521,11 @@ void *parse_trace_file_thread(void *param) {
         double inter_arrival_time = get_elapsed_time_in_ms(&last_arrival_time, &packet->arrival_time);
         last_arrival_time = packet->arrival_time;
 
-        total_inter_arrival_time += inter_arrival_time;
-        total_packets_arrived++;
+        stats.total_inter_arrival_time += inter_arrival_time;
+        stats.total_packets_arrived++;
 
         if (packet->tokens_needed > B) {
-            total_packets_dropped++;
+            stats.total_packets_dropped++;
             printf("%012.3fms: p%d arrives, needs %d tokens, inter-arrival time = %.6gms, dropped\n",
                    get_elapsed_time_in_ms(&emulation_start, &packet->arrival_time),
                    packet->id, packet->tokens_needed, inter_arrival_time);
@@ -425,7 +537,7 @@ void *parse_trace_file_thread(void *param) {
                get_elapsed_time_in_ms(&emulation_start, &packet->arrival_time), i, tokens_needed, inter_arrival_time);
 
         pthread_mutex_lock(&queue_lock);
-        if (My402ListAppend(&Q1, packet) != 1) {
+        if (My402ListAppendElem(&Q1, &packet->link) != 1) {
             fprintf(stderr, "Failed to append packet to Q1\n");
             pthread_mutex_unlock(&queue_lock);
             exit(EXIT_FAILURE);
@@ -438,50 +550,89 @@ void *parse_trace_file_thread(void *param) {
     return NULL;
 }
 
-void print_statistics() {
-    printf("\nStatistics:\n");
+int init_stats(EmulationStats *stats, int num_servers) {
+    memset(stats, 0, sizeof(*stats));
+    stats->servers = (ServerStats *)calloc(num_servers, sizeof(ServerStats));
+    if (stats->servers == NULL) return FALSE;
+    stats->num_servers = num_servers;
+    return TRUE;
+}
 
-    if (total_packets_arrived > 1) {
-        printf("\n\taverage packet inter-arrival time = %.6g\n", (total_inter_arrival_time / (total_packets_arrived)) / 1000.0);
-    } else {
-        printf("\n\taverage packet inter-arrival time = N/A (no packets arrived)\n");
-    }
+void free_stats(EmulationStats *stats) {
+    free(stats->servers);
+    stats->servers = NULL;
+    stats->num_servers = 0;
+}
 
-    if (total_packets_served > 0) {
-        printf("\taverage packet service time = %.6g\n", (total_service_time / total_packets_served) / 1000.0);
-    } else {
-        printf("\taverage packet service time = N/A (no packets served)\n");
+static void add_metric(Metric *metric, const char *name, int ok, double value, const char *na, int new_group) {
+    snprintf(metric->name, sizeof(metric->name), "%s", name);
+    metric->value = ok ? value : NAN;
+    metric->na = ok ? NULL : na;
+    metric->new_group = new_group;
+}
+
+// Fill in metrics, which must have room for MAX_METRICS(stats->num_servers),
+// and return how many there are.
+int compute_metrics(EmulationStats *stats, Metric *metrics) {
+    ServerStats total;
+    int n = 0;
+
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < stats->num_servers; i++) {
+        total.packets_served += stats->servers[i].packets_served;
+        total.time_in_Q2 += stats->servers[i].time_in_Q2;
+        total.service_time += stats->servers[i].service_time;
+        total.time_in_system += stats->servers[i].time_in_system;
+        total.system_time_squared += stats->servers[i].system_time_squared;
     }
 
-    gettimeofday(&emulation_end, NULL);
-    double emulation_time = get_elapsed_time_in_ms(&emulation_start, &emulation_end) / 1000.0;
-
-    printf("\n\taverage number of packets in Q1 = %.6g\n", total_time_in_Q1 / (emulation_time * 1000.0));
-    printf("\taverage number of packets in Q2 = %.6g\n", total_time_in_Q2 / (emulation_time * 1000.0));
-    printf("\taverage number of packets at S1 = %.6g\n", total_time_in_S1 / (emulation_time * 1000.0));
-    printf("\taverage number of packets at S2 = %.6g\n", total_time_in_S2 / (emulation_time * 1000.0));
-
-    if (total_packets_served > 0) {
-        double avg_time_in_system = (total_time_in_system / total_packets_served) / 1000.0;
-        double variance = ((total_system_time_squared / total_packets_served) / 1000000.0) - (avg_time_in_system * avg_time_in_system);
-        double stddev = sqrt(variance);
-        printf("\n\taverage time a packet spent in system = %.6g\n", avg_time_in_system);
-        printf("\tstandard deviation for time spent in system = %.6g\n", stddev);
-    } else {
-        printf("\n\taverage time a packet spent in system = N/A (no packets served)\n");
-        printf("\tstandard deviation for time spent in system = N/A\n");
+    add_metric(&metrics[n++], "average packet inter-arrival time", stats->total_packets_arrived > 1,
+               (stats->total_inter_arrival_time / (stats->total_packets_arrived)) / 1000.0, "N/A (no packets arrived)", TRUE);
+    add_metric(&metrics[n++], "average packet service time", total.packets_served > 0,
+               (total.service_time / total.packets_served) / 1000.0, "N/A (no packets served)", FALSE);
+
+    double emulation_time = stats->emulation_time_ms / 1000.0;
+
+    add_metric(&metrics[n++], "average number of packets in Q1", TRUE,
+               stats->total_time_in_Q1 / (emulation_time * 1000.0), NULL, TRUE);
+    add_metric(&metrics[n++], "average number of packets in Q2", TRUE,
+               total.time_in_Q2 / (emulation_time * 1000.0), NULL, FALSE);
+    for (int i = 0; i < stats->num_servers; i++) {
+        char name[sizeof(metrics[n].name)];
+        snprintf(name, sizeof(name), "average number of packets at S%d", i + 1);
+        add_metric(&metrics[n++], name, TRUE, stats->servers[i].service_time / (emulation_time * 1000.0), NULL, FALSE);
     }
 
-    if (total_tokens_generated > 0) {
-        printf("\n\ttoken drop probability = %.6g\n", (double)total_tokens_dropped / total_tokens_generated);
-    } else {
-        printf("\n\ttoken drop probability = N/A (no tokens generated)\n");
+    double avg_time_in_system = 0.0, stddev = 0.0;
+    if (total.packets_served > 0) {
+        avg_time_in_system = (total.time_in_system / total.packets_served) / 1000.0;
+        double variance = ((total.system_time_squared / total.packets_served) / 1000000.0) - (avg_time_in_system * avg_time_in_system);
+        stddev = sqrt(variance);
     }
+    add_metric(&metrics[n++], "average time a packet spent in system", total.packets_served > 0,
+               avg_time_in_system, "N/A (no packets served)", TRUE);
+    add_metric(&metrics[n++], "standard deviation for time spent in system", total.packets_served > 0,
+               stddev, "N/A", FALSE);
+
+    add_metric(&metrics[n++], "token drop probability", stats->total_tokens_generated > 0,
+               (double)stats->total_tokens_dropped / stats->total_tokens_generated, "N/A (no tokens generated)", TRUE);
+    add_metric(&metrics[n++], "packet drop probability", stats->total_packets_arrived > 0,
+               (double)stats->total_packets_dropped / stats->total_packets_arrived, "N/A (no packets arrived)", FALSE);
+    return n;
+}
 
-    if (total_packets_arrived > 0) {
-        printf("\tpacket drop probability = %.6g\n", (double)total_packets_dropped / total_packets_arrived);
-    } else {
-        printf("\tpacket drop probability = N/A (no packets arrived)\n");
+void print_statistics(EmulationStats *stats) {
+    Metric metrics[MAX_METRICS(stats->num_servers)];
+    int n = compute_metrics(stats, metrics);
+
+    printf("\nStatistics:\n");
+    for (int i = 0; i < n; i++) {
+        if (metrics[i].new_group) printf("\n");
+        if (metrics[i].na != NULL) {
+            printf("\t%s = %s\n", metrics[i].name, metrics[i].na);
+        } else {
+            printf("\t%s = %.6g\n", metrics[i].name, metrics[i].value);
+        }
     }
 }
 
@@ -500,20 +651,28 @@ void* sigint_handler_thread(void* arg) {
 
     printf("\nSIGINT caught, no new packets or tokens will be allowed\n");
 
-    is_emulation_finished = 1;
-
     pthread_cancel(packet_thread);
     pthread_cancel(token_thread);
 
     pthread_mutex_lock(&queue_lock);
+    is_emulation_finished = 1;
     remove_packets_from_queue(&Q1);
-    remove_packets_from_queue(&Q2);
+    My402ListElem *elem = NULL;
+    while ((elem = DispatchPoll(&Q2, 0)) != NULL) {
+        Packet *packet = My402ListEntry(elem, Packet, link);
+        printf("p%d removed from queue\n", packet->id);
+        free(packet);
+    }
+    DispatchClose(&Q2);
     pthread_mutex_unlock(&queue_lock);
 
-    pthread_cancel(server1);
-    pthread_cancel(server2);
+    for (int i = 0; i < num_servers; i++) {
+        pthread_cancel(server_threads[i]);
+    }
 
-    print_statistics();
+    gettimeofday(&emulation_end, NULL);
+    stats.emulation_time_ms = get_elapsed_time_in_ms(&emulation_start, &emulation_end);
+    print_statistics(&stats);
 
     exit(0);
 }
@@ -521,7 +680,7 @@ void* sigint_handler_thread(void* arg) {
 void remove_packets_from_queue(My402List* queue) {
     while (!My402ListEmpty(queue)) {
         My402ListElem *elem = My402ListFirst(queue);
-        Packet *packet = (Packet *)elem->obj;
+        Packet *packet = My402ListEntry(elem, Packet, link);
         My402ListUnlink(queue, elem);
         printf("p%d removed from queue\n", packet->id);
         free(packet);
@@ -0,0 +1,80 @@
+#ifndef _WARMUP2_H_
+#define _WARMUP2_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Statistics of one server, only updated by that server's thread
+typedef struct ServerStats {
+    int packets_served;
+    double time_in_Q2;
+    double service_time;
+    double time_in_system;
+    double system_time_squared;
+} ServerStats;
+
+// Everything print_statistics() reports on, for one run
+typedef struct EmulationStats {
+    double total_inter_arrival_time;
+    double total_time_in_Q1;
+
+    int total_packets_arrived;
+    int total_packets_dropped;
+    int total_tokens_generated;
+    int total_tokens_dropped;
+
+    int num_servers;
+    ServerStats *servers;
+
+    double emulation_time_ms;  // set when the run ends
+} EmulationStats;
+
+// The command line parameters of a run
+typedef struct EmulationParams {
+    double lambda;
+    double mu;
+    double r;
+    int B;
+    int P;
+    int num_packets;
+    int num_servers;
+    const char *tracefile;  // NULL in deterministic mode
+    uint64_t seed;          // not 0: exponential inter-arrival and service times, see simulate()
+} EmulationParams;
+
+// One line of print_statistics()
+typedef struct Metric {
+    char name[64];
+    double value;    // NAN if there is no figure
+    const char *na;  // what is printed instead, NULL if there is a figure
+    int new_group;   // a blank line comes before it
+} Metric;
+
+#define MAX_METRICS(num_servers) (8 + (num_servers))
+
+extern int  init_stats(EmulationStats*, int);
+extern void free_stats(EmulationStats*);
+extern int  compute_metrics(EmulationStats*, Metric*);
+extern void print_statistics(EmulationStats*);
+
+extern void simulate(EmulationParams*, EmulationStats*, FILE*);
+
+extern void run_parallel(int, void (*)(int, void*), void*);
+extern uint64_t replication_seed(uint64_t, int);
+extern void run_replications(EmulationParams*, int, uint64_t);
+
+// The values a swept parameter takes
+typedef struct SweepRange {
+    int count;
+    double *values;
+} SweepRange;
+
+enum { SWEEP_LAMBDA, SWEEP_MU, SWEEP_R, SWEEP_B, SWEEP_P, NUM_SWEEP_PARAMS };
+
+// Limit on the values of one range and on the grid points of a sweep
+#define MAX_SWEEP_POINTS 100000
+
+extern int parse_range(const char*, SweepRange*, int);
+extern int run_sweep(EmulationParams*, SweepRange*, int, uint64_t, FILE*, char);
+
+#endif /*_WARMUP2_H_*/